@@ -0,0 +1,41 @@
+#!/bin/bash
+
+# compare cc or sssp on the superstep engine and on the asynchronous engine (-a):
+# the total vertex updates and the computing time of each, on 1 to $3 ranks
+
+# parameter
+# $1 program, cc or sssp
+# $2 dataset (see converse.py)
+# $3 max number of ranks (optional, 2 by default)
+# $4 hosts, e.g. node1,node2 (optional, local run if omitted)
+# $5 options given to both engines (optional), e.g. "-w -s 0" for sssp on a weighted graph, "-w -s 0 -d 4" to run both in buckets
+
+program=$1
+dataset=$2
+max_ranks=${3:-2}
+hosts=$4
+options=$5
+
+threshold=1000
+
+if [ -n "$hosts" ]; then
+	launch="mpirun -hosts $hosts"
+else
+	launch="mpirun"
+fi
+
+for np in $(seq 1 $max_ranks)
+do
+	for mode in sync async
+	do
+		if [ "$mode" = async ]; then
+			option=-a
+		else
+			option=
+		fi
+		output=$($launch -np $np ./$program -g $dataset -t $threshold $options $option 2>&1)
+		updates=$(echo "$output" | grep "Total vertex updates:" | awk '{print $NF}')
+		time=$(echo "$output" | grep "Total computing time:" | awk '{print $(NF-1)}')
+		echo "program: $program, np: $np, engine: $mode, vertex updates: $updates, computing time: $time (s)"
+	done
+done
@@ -1,5 +1,9 @@
 
 import struct
+import sys
+
+# --id64: write 64-bit vertex ids, load with -i 64 (and build with make ID64=1 for ids beyond 32 bits)
+id_format = "q" if "--id64" in sys.argv[1:] else "i"
 
 path = input().strip()
 
@@ -13,6 +17,11 @@ with open(new_file, 'wb+') as file:
 	for line in lines:
 		if line[0]=='#':
 			continue
-		src, dst = tuple(map(int, line.split()))	
-		binary = struct.pack("2i", src, dst)
+		fields = line.split()
+		src, dst = int(fields[0]), int(fields[1])
+		if len(fields) > 2:
+			# weighted edge: src dst weight, load with -w
+			binary = struct.pack("=2" + id_format + "f", src, dst, float(fields[2]))
+		else:
+			binary = struct.pack("=2" + id_format, src, dst)
 		file.write(binary)
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# compare LLC misses and gather time of the local id orders
+# (0: none, 1: hub clustering, 2: reverse Cuthill-McKee)
+
+# parameter
+# $1 application (pagerank, cc, sssp, kcore)
+# $2 dataset
+# $3 hosts, e.g. node1,node2 (optional, local run if omitted)
+
+program=$1
+dataset=$2
+hosts=$3
+
+threshold=1000
+perf_dir=$(mktemp -d)
+
+if [ -n "$hosts" ]; then
+	launch="mpirun -hosts $hosts"
+else
+	launch="mpirun"
+fi
+
+if command -v perf > /dev/null; then
+	profile="perf stat -x, -e LLC-loads,LLC-load-misses -o $perf_dir/perf.\$order.\${OMPI_COMM_WORLD_RANK:-\$PMI_RANK}"
+else
+	echo "perf not found, LLC misses are not reported"
+fi
+
+for order in 0 1 2
+do
+	output=$($launch sh -c "order=$order; $profile ./$program -g $dataset -t $threshold -r $order" 2>&1)
+	gather=$(echo "$output" | grep "gather compute time" | awk '{sum+=$6} END {print sum/NR}')
+	computing=$(echo "$output" | grep "Total computing time" | awk '{print $4}')
+	loads=$(cat $perf_dir/perf.$order.* 2>/dev/null | grep "LLC-loads" | awk -F, '{sum+=$1} END {print sum}')
+	misses=$(cat $perf_dir/perf.$order.* 2>/dev/null | grep "LLC-load-misses" | awk -F, '{sum+=$1} END {print sum}')
+	echo "reorder: $order, avg gather time: $gather, computing time: $computing, LLC loads: $loads, LLC misses: $misses"
+done
+
+rm -rf $perf_dir
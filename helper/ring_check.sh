@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# check ring across ranks: its hop distances must be those of unweighted sssp
+# run from src, after make; exits with 1 on the first difference
+
+# parameter
+# $1 dataset, unweighted (optional, a random graph of 2000 vertices is generated if omitted)
+# $2 source (optional, 0 by default)
+# $3 hosts, e.g. node1,node2 (optional, local run if omitted)
+
+dataset=$1
+source=${2:-0}
+hosts=$3
+
+# low enough for high degree vertices in the random graph
+threshold=20
+
+if [ -n "$hosts" ]; then
+	launch="mpirun -hosts $hosts"
+else
+	launch="mpirun"
+fi
+
+tmp=$(mktemp -d)
+trap "rm -rf $tmp" EXIT
+
+if [ -z "$dataset" ]; then
+	awk 'BEGIN {srand(1); for (i = 0; i < 20000; i++) print int(rand() * 2000), int(rand() * 2000)}' > $tmp/random.txt
+	converse=$(cd $(dirname $0) && pwd)/converse.py
+	(cd $tmp && echo random.txt | python3 $converse)
+	dataset=$tmp/random.bin
+fi
+
+for np in 1 2 3
+do
+	for program in sssp ring
+	do
+		# mpirun may report a nonzero status once the results are written, so the results are checked instead
+		$launch -np $np ./$program -g $dataset -t $threshold -s $source -o $tmp/$program.$np -O 2 > $tmp/$program.$np.log 2>&1
+		if [ ! -s $tmp/$program.$np ]; then
+			echo "$program np=$np: no results, see its log below"
+			cat $tmp/$program.$np.log
+			exit 1
+		fi
+		sort -n $tmp/$program.$np > $tmp/$program.$np.sorted
+	done
+	if ! diff -q $tmp/sssp.1.sorted $tmp/sssp.$np.sorted > /dev/null || ! diff -q $tmp/sssp.1.sorted $tmp/ring.$np.sorted > /dev/null; then
+		echo "np=$np: ring differs from sssp"
+		diff $tmp/sssp.1.sorted $tmp/ring.$np.sorted | head
+		exit 1
+	fi
+	echo "np=$np: ring matches sssp, $(wc -l < $tmp/ring.$np.sorted) vertices"
+done
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+# compare the throughput of shortest paths from many sources:
+# one sssp run per source, msssp with one source per batch, and msssp with full batches
+
+# parameter
+# $1 dataset, weighted (see converse.py)
+# $2 number of sources, picked at random below $3
+# $3 number of vertices
+# $4 hosts, e.g. node1,node2 (optional, local run if omitted)
+
+dataset=$1
+num_sources=$2
+num_vertices=$3
+hosts=$4
+
+threshold=1000
+
+if [ -n "$hosts" ]; then
+	launch="mpirun -hosts $hosts"
+else
+	launch="mpirun"
+fi
+
+sources=$(shuf -i 0-$((num_vertices - 1)) -n $num_sources | paste -sd,)
+
+start=$(date +%s.%N)
+for source in ${sources//,/ }
+do
+	$launch ./sssp -g $dataset -t $threshold -w -s $source > /dev/null 2>&1
+done
+end=$(date +%s.%N)
+echo "sssp runs: $num_sources, wall time: $(awk "BEGIN {print $end - $start}") (s), sources per second: $(awk "BEGIN {print $num_sources / ($end - $start)}")"
+
+for batch in 1 16
+do
+	start=$(date +%s.%N)
+	output=$($launch ./msssp -g $dataset -t $threshold -w -s $sources -b $batch 2>&1)
+	end=$(date +%s.%N)
+	echo "msssp sources per batch: $batch, wall time: $(awk "BEGIN {print $end - $start}") (s), $(echo "$output" | grep "Sources:")"
+done
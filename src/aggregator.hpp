@@ -0,0 +1,99 @@
+#ifndef AGGREGATOR
+#define AGGREGATOR
+
+#include <mpi.h>
+#include <omp.h>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+/*
+	global aggregators of a vertex program
+	the computing threads add values during apply, the engine then combines them across threads and
+	starts a non-blocking reduction across ranks, which completes by the end of the iteration
+	the result is readable through get() in terminate() and in the next iteration
+*/
+class AggregatorBase
+{
+public:
+	virtual ~AggregatorBase() {}
+	virtual void init(int num_threads) = 0;
+	virtual void start(MPI_Comm comm) = 0;
+	virtual void finish() = 0;
+	// the result of the last iteration, kept in checkpoints
+	virtual size_t bytes() const = 0;
+	virtual void save(char *buf) const = 0;
+	virtual void load(const char *buf) = 0;
+};
+
+template<class T>
+class Aggregator: public AggregatorBase
+{
+public:
+	typedef T (*Combine)(T x, T y);
+
+	static T sum(T x, T y) {return x + y;}
+	static T min(T x, T y) {return std::min(x, y);}
+	static T max(T x, T y) {return std::max(x, y);}
+
+	// combine must be associative and commutative, identity its neutral element
+	Aggregator(Combine combine, T identity): combine(combine), identity(identity), value(identity) {}
+	~Aggregator() {}
+
+	inline void add(T x)
+	{
+		T &local = partial[omp_get_thread_num()].value;
+		local = combine(local, x);
+	}
+	inline T get() const {return value;}
+
+	void init(int num_threads)
+	{
+		partial.assign(num_threads, Partial{identity});
+	}
+
+	void start(MPI_Comm comm)
+	{
+		local = identity;
+		for(auto &p : partial)
+		{
+			local = combine(local, p.value);
+			p.value = identity;
+		}
+		int size;
+		MPI_Comm_size(comm, &size);
+		ranks.resize(size);
+		// partial values of all ranks are gathered and combined locally, so that any combine works
+		MPI_Iallgather(&local, sizeof(T), MPI_BYTE, ranks.data(), sizeof(T), MPI_BYTE, comm, &request);
+	}
+
+	void finish()
+	{
+		MPI_Wait(&request, MPI_STATUS_IGNORE);
+		value = identity;
+		for(auto &x : ranks)
+			value = combine(value, x);
+	}
+
+	size_t bytes() const {return sizeof(T);}
+	void save(char *buf) const {memcpy(buf, &value, sizeof(T));}
+	void load(const char *buf) {memcpy(&value, buf, sizeof(T));}
+
+private:
+	// one cache line per thread
+	struct Partial
+	{
+		T value;
+		char pad[64];
+	};
+
+	Combine combine;
+	T identity;
+	T value;
+	T local;
+	std::vector<Partial> partial;
+	std::vector<T> ranks;
+	MPI_Request request;
+};
+
+#endif
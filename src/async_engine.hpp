@@ -0,0 +1,518 @@
+#ifndef ASYNC_ENGINE
+#define ASYNC_ENGINE
+
+#include <mpi.h>
+#include <deque>
+#include <mutex>
+#include <limits.h>
+#include "vertexprogram.hpp"
+#include "sender.hpp"
+
+/*
+	asynchronous engine, without global supersteps
+	every local vertex is scheduled on per-thread work queues and processed as soon as a thread is free:
+		a replica gathers over its local edges, a mirror sends its partial to the master,
+		the master combines it into its accumulator and applies, then sends its new value to its mirrors
+		a replica whose value changed scatters over its local edges and schedules the local nbrs to gather
+	mirror partials and values are processed by the worker threads as they arrive
+	the ranks stop once two consecutive non-blocking reductions of the sent and processed blocks are equal
+	with nothing in flight, while no local work is left (the four counter method)
+
+	a master keeps combining partials across activations and only the replicas sharing an edge with a
+	changed vertex gather again, so op must be idempotent and values may only move in the direction of op,
+	as for the min labels of cc and the distances of sssp
+
+	under priority scheduling (see VertexProgram::bucket_width), a master whose priority with its accumulator
+	falls in a later bucket than the current one is postponed instead of applied, as in the superstep engine,
+	so that sssp does not spread distances that are replaced later
+	once the termination waves find every rank idle, the ranks agree on the lowest bucket still holding postponed
+	masters and apply them, and they stop when no bucket is left
+*/
+template<class KeyType, class ValueType, class WireType = ValueType>
+class AsyncEngine: public MesgHandler
+{
+private:
+	typedef Vertex<KeyType, ValueType> VertexType;
+	typedef Controller<KeyType, ValueType> ControllerType;
+	typedef MessageBuffer<KeyType, ValueType> MesgBuf;
+	typedef typename MesgBuf::template Sync<WireType> Sync;
+	typedef typename Sync::Mesg SyncMesg;
+	typedef Graph<KeyType, ValueType> GraphType;
+	typedef VertexProgram<KeyType, ValueType> VertexProgType;
+	typedef Sender<SyncMesg> SenderType;
+
+	// pending work of a vertex, BUSY while a thread processes it
+	enum
+	{
+		GATHER = 1,
+		APPLY = 2,
+		BUSY = 4
+	};
+
+	struct TaskQueue
+	{
+		std::mutex lock;
+		std::deque<LocalId> tasks;
+		volatile size_t size = 0;
+		char pad[64];
+	};
+
+	ControllerType *controller;
+	Communicator *comm;
+	MesgBuf *mesg_buf;
+	GraphType *graph;
+	VertexProgType *v_prog;
+
+	int rank;
+	int mpi_size;
+
+	// local vertices of Graph::local_vertex before high_master_begin are low masters and mirrors
+	LocalId num_low_master;
+	LocalId high_master_begin;
+	LocalId high_master_end;
+
+	// accumulator of a master, latest value received by a mirror
+	ValueType *acc;
+	uint8_t *state;
+	TaskQueue *queue;
+
+	// termination detection
+	volatile long pending = 0; // scheduled vertices not processed yet
+	volatile int handling = 0; // received blocks being processed
+	volatile unsigned long epoch = 0; // changes whenever a block is received or sent
+	volatile unsigned long num_sent = 0;
+	volatile unsigned long num_recv = 0;
+	volatile bool *dirty; // buffered messages of each thread
+	volatile bool done = false;
+	bool in_wave = false;
+	unsigned long wave[2];
+	unsigned long last_wave[2] = {ULONG_MAX, 0};
+	MPI_Request wave_req;
+
+	unsigned long *num_updates;
+
+	// priority scheduling, off when the width is not positive
+	double width;
+	long bucket = 0; // the bucket being applied
+	static const long NO_BUCKET = LONG_MAX;
+	long *postponed_bucket = NULL; // bucket of every postponed master, NO_BUCKET when not postponed
+	std::vector<LocalId> *postponed = NULL; // per computing thread, may still hold masters applied since
+	char *listed = NULL; // masters in one of the lists above
+	unsigned long *num_postponed = NULL; // applies postponed by every computing thread
+	int num_buckets = 0;
+
+	inline bool is_master(LocalId index)
+	{
+		return index < num_low_master || (index >= high_master_begin && index < high_master_end);
+	}
+	inline void schedule(LocalId index, uint8_t work, int q);
+	inline bool pop(int thread_id, LocalId *index);
+	inline void process(LocalId index, int thread_id, SenderType *master_sender, SenderType *mirror_sender);
+	inline void update(LocalId index, int thread_id, SenderType *mirror_sender);
+	inline bool postpone(LocalId index, ValueType total, int thread_id);
+	inline void next_bucket();
+	inline bool idle();
+	inline void detect_termination();
+
+public:
+	// WireType is that of the program, as for Engine
+	template<class ProgType>
+	AsyncEngine(ControllerType *controller, GraphType *graph, ProgType *v_prog):controller(controller), graph(graph), v_prog(v_prog)
+	{
+		static_assert(std::is_same<WireType, typename ProgType::WireType>::value, "the engine must send the wire type of the program");
+		comm = controller->comm;
+		rank = comm->get_rank();
+		mpi_size = comm->get_size();
+		mesg_buf = controller->mesg_buf;
+
+		mesg_buf->init(graph, v_prog);
+
+		num_low_master = graph->ltov_low_master.size();
+		high_master_begin = num_low_master + graph->ltov_low_mirror.size();
+		high_master_end = high_master_begin + graph->ltov_high_master.size();
+
+		size_t num = graph->local_vertex.size();
+		acc = new ValueType[num];
+		for (size_t i = 0; i < num; ++i)
+			acc[i] = v_prog->acc_init;
+		state = new uint8_t[num]();
+		queue = new TaskQueue[COMP_THREADS];
+		dirty = new bool[COMP_THREADS]();
+		num_updates = new unsigned long[COMP_THREADS]();
+
+		width = v_prog->bucket_width();
+		if(width > 0)
+		{
+			postponed_bucket = new long[num];
+			std::fill(postponed_bucket, postponed_bucket + num, NO_BUCKET);
+			postponed = new std::vector<LocalId>[COMP_THREADS];
+			listed = new char[num]();
+			num_postponed = new unsigned long[COMP_THREADS]();
+		}
+
+		// the initially active vertices gather first, and their masters apply once at least
+		LocalId offset[4] = {0, num_low_master, high_master_begin, high_master_end};
+		BitMap *active[4] = {&graph->low_active_master, &graph->low_active_mirror, &graph->high_active_master, &graph->high_active_mirror};
+		for (int i = 0; i < 4; ++i)
+		{
+			size_t lid;
+			while(active[i]->next_bit(&lid))
+				schedule(offset[i] + lid, GATHER | APPLY, (offset[i] + lid) % COMP_THREADS);
+			active[i]->clear();
+		}
+	}
+	~AsyncEngine()
+	{
+		delete []acc;
+		delete []state;
+		delete []queue;
+		delete []dirty;
+		delete []num_updates;
+		delete []postponed_bucket;
+		delete []postponed;
+		delete []listed;
+		delete []num_postponed;
+	}
+
+	bool process_mesg(int tag, void *buf);
+	void run();
+};
+
+template<class KeyType, class ValueType, class WireType>
+void AsyncEngine<KeyType, ValueType, WireType>::run()
+{
+	// before the barrier, as the other ranks may send right after it
+	mesg_buf->handler = this;
+	MPI_Barrier(comm->mpi_comm);
+	double start = MPI_Wtime();
+
+	#pragma omp parallel num_threads(COMP_THREADS)
+	{
+		int thread_id = omp_get_thread_num();
+		SenderType *master_sender = new SenderType(comm, ASYNC_MASTER);
+		SenderType *mirror_sender = new SenderType(comm, ASYNC_MIRROR);
+		size_t flushed = 0;
+		TRACE_SCOPE("async");
+		while(!done)
+		{
+			LocalId index;
+			if(pop(thread_id, &index))
+			{
+				process(index, thread_id, master_sender, mirror_sender);
+				__sync_fetch_and_sub(&pending, 1);
+				continue;
+			}
+			if(dirty[thread_id])
+			{
+				master_sender->flush();
+				mirror_sender->flush();
+				size_t sent = master_sender->sent_blocks() + mirror_sender->sent_blocks();
+				__sync_fetch_and_add(&num_sent, sent - flushed);
+				__sync_fetch_and_add(&epoch, 1);
+				flushed = sent;
+				dirty[thread_id] = false;
+				continue;
+			}
+			if(0 == thread_id)
+				detect_termination();
+			else
+				usleep(1);
+		}
+		delete master_sender;
+		delete mirror_sender;
+	}
+
+	mesg_buf->handler = NULL;
+	unsigned long local_updates = 0, global_updates;
+	for (int i = 0; i < COMP_THREADS; ++i)
+		local_updates += num_updates[i];
+	MPI_Reduce(&local_updates, &global_updates, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
+	printf("Rank: %d, async updates: %lu, sent blocks: %lu\n", rank, local_updates, num_sent);
+	unsigned long local_postponed = 0, global_postponed = 0;
+	if(width > 0)
+		for (int i = 0; i < COMP_THREADS; ++i)
+			local_postponed += num_postponed[i];
+	MPI_Reduce(&local_postponed, &global_postponed, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
+	MPI_Barrier(comm->mpi_comm);
+	if(0 == rank)
+	{
+		if(width > 0)
+			printf("Buckets: %d, postponed applies: %lu\n", num_buckets, global_postponed);
+		printf("Total vertex updates: %lu\n", global_updates);
+		printf("Total computing time: %lf (s)\n", MPI_Wtime() - start);
+	}
+}
+
+/*
+	add work to a vertex, which is queued unless it is queued or processed already
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void AsyncEngine<KeyType, ValueType, WireType>::schedule(LocalId index, uint8_t work, int q)
+{
+	if(__atomic_fetch_or(state + index, work, __ATOMIC_ACQ_REL))
+		return;
+	__sync_fetch_and_add(&pending, 1);
+	TaskQueue &task_queue = queue[q];
+	std::lock_guard<std::mutex> lock(task_queue.lock);
+	task_queue.tasks.push_back(index);
+	task_queue.size = task_queue.tasks.size();
+}
+
+// the own queue first, then steal from the others
+template<class KeyType, class ValueType, class WireType>
+inline bool AsyncEngine<KeyType, ValueType, WireType>::pop(int thread_id, LocalId *index)
+{
+	for (int i = 0; i < COMP_THREADS; ++i)
+	{
+		TaskQueue &task_queue = queue[(thread_id + i) % COMP_THREADS];
+		if(!task_queue.size)
+			continue;
+		std::lock_guard<std::mutex> lock(task_queue.lock);
+		if(task_queue.tasks.empty())
+			continue;
+		*index = task_queue.tasks.front();
+		task_queue.tasks.pop_front();
+		task_queue.size = task_queue.tasks.size();
+		return true;
+	}
+	return false;
+}
+
+template<class KeyType, class ValueType, class WireType>
+inline void AsyncEngine<KeyType, ValueType, WireType>::process(LocalId index, int thread_id, SenderType *master_sender, SenderType *mirror_sender)
+{
+	VertexType *v = graph->local_vertex[index];
+	uint8_t work = __atomic_exchange_n(state + index, (uint8_t)BUSY, __ATOMIC_ACQ_REL) & ~BUSY;
+	while(true)
+	{
+		if(GATHER & work)
+		{
+			ValueType partial = v_prog->acc_init;
+			bool gathered = false;
+			auto gather_nbr = [&](VertexType *nbr_v, WeightType weight)
+			{
+				partial = v_prog->op(v_prog->gather(*v, *nbr_v, weight), partial);
+				gathered = true;
+			};
+			if(IN_EDGES & v_prog->gather_edge(*v))
+				graph->for_each_in_nbr(*v, gather_nbr);
+			if(OUT_EDGES & v_prog->gather_edge(*v))
+				graph->for_each_out_nbr(*v, gather_nbr);
+
+			if(is_master(index))
+			{
+				if(mesg_buf->accumulate(acc + index, partial))
+					work |= APPLY;
+			}
+			else if(gathered)
+			{
+				KeyType gid = v->get_id();
+				Sync::put(master_sender, graph->hash(gid), gid, (WireType)partial);
+				dirty[thread_id] = true;
+			}
+		}
+		if(APPLY & work)
+			update(index, thread_id, mirror_sender);
+
+		// new work arrived while processing
+		uint8_t expected = BUSY;
+		if(__atomic_compare_exchange_n(state + index, &expected, (uint8_t)0, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			break;
+		work = __atomic_exchange_n(state + index, (uint8_t)BUSY, __ATOMIC_ACQ_REL) & ~BUSY;
+	}
+}
+
+/*
+	a master applies its accumulator and sends its new value to its mirrors, a mirror takes the value received
+	then the changed replica scatters over its local edges
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void AsyncEngine<KeyType, ValueType, WireType>::update(LocalId index, int thread_id, SenderType *mirror_sender)
+{
+	VertexType *v = graph->local_vertex[index];
+	ValueType total = acc[index];
+	if(is_master(index))
+	{
+		if(postpone(index, total, thread_id))
+			return;
+		v_prog->apply(*v, total);
+		num_updates[thread_id]++;
+		if(!v->get_change())
+			return;
+		KeyType gid = v->get_id();
+		auto pair_it = (graph->mirror).find(gid);
+		if((graph->mirror).end() != pair_it)
+		{
+			for (int mirror_rank : pair_it->second)
+				Sync::put(mirror_sender, mirror_rank, gid, (WireType)v->get_value());
+			dirty[thread_id] = true;
+		}
+	}
+	else
+	{
+		ValueType old_value = v->get_value();
+		v->set_value(v_prog->op(old_value, total));
+		v->set_change(v->get_value() - old_value);
+		if(!v->get_change())
+			return;
+	}
+
+	auto scatter_nbr = [&](VertexType *nbr_v, WeightType weight)
+	{
+		if(v_prog->scatter(*v, *nbr_v, weight))
+			schedule(nbr_v->index, GATHER, thread_id);
+	};
+	if(IN_EDGES & v_prog->scatter_edge(*v))
+		graph->for_each_in_nbr(*v, scatter_nbr);
+	if(OUT_EDGES & v_prog->scatter_edge(*v))
+		graph->for_each_out_nbr(*v, scatter_nbr);
+}
+
+/*
+	a master whose priority with total falls in a later bucket than the current one keeps its value until that bucket,
+	only the thread processing the master touches its entries
+*/
+template<class KeyType, class ValueType, class WireType>
+inline bool AsyncEngine<KeyType, ValueType, WireType>::postpone(LocalId index, ValueType total, int thread_id)
+{
+	if(width <= 0)
+		return false;
+	long b = (long)(v_prog->priority(*graph->local_vertex[index], total) / width);
+	if(b <= bucket)
+	{
+		postponed_bucket[index] = NO_BUCKET;
+		return false;
+	}
+	if(!listed[index])
+	{
+		listed[index] = 1;
+		postponed[thread_id].push_back(index);
+	}
+	postponed_bucket[index] = b;
+	num_postponed[thread_id]++;
+	return true;
+}
+
+/*
+	called by thread 0 once every rank is idle, so that no other thread touches the postponed masters:
+	the masters postponed to the lowest bucket left are scheduled to apply, which starts that bucket,
+	and the run is done when no bucket is left
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void AsyncEngine<KeyType, ValueType, WireType>::next_bucket()
+{
+	std::vector<LocalId> masters;
+	long local_min = NO_BUCKET;
+	for (int i = 0; i < COMP_THREADS; ++i)
+	{
+		for(auto index : postponed[i])
+		{
+			// applied since
+			if(NO_BUCKET == postponed_bucket[index])
+			{
+				listed[index] = 0;
+				continue;
+			}
+			masters.push_back(index);
+			local_min = std::min(local_min, postponed_bucket[index]);
+		}
+		postponed[i].clear();
+	}
+	MPI_Allreduce(&local_min, &bucket, 1, MPI_LONG, MPI_MIN, comm->mpi_comm);
+	if(NO_BUCKET == bucket)
+	{
+		done = true;
+		return;
+	}
+	num_buckets++;
+	log("Rank: %d, bucket: %ld\n", rank, bucket);
+
+	// the later ones are set aside before any is scheduled, after which other threads may postpone them again
+	std::vector<LocalId> current;
+	for(auto index : masters)
+	{
+		if(postponed_bucket[index] > bucket)
+		{
+			postponed[0].push_back(index);
+			continue;
+		}
+		listed[index] = 0;
+		postponed_bucket[index] = NO_BUCKET;
+		current.push_back(index);
+	}
+	// the next bucket is done after two more stable waves
+	last_wave[0] = ULONG_MAX;
+	last_wave[1] = 0;
+	for(auto index : current)
+		schedule(index, APPLY, index % COMP_THREADS);
+}
+
+/*
+	called by the worker threads
+*/
+template<class KeyType, class ValueType, class WireType>
+bool AsyncEngine<KeyType, ValueType, WireType>::process_mesg(int tag, void *buf)
+{
+	if(ASYNC_MASTER != tag && ASYNC_MIRROR != tag)
+		return false;
+	__sync_fetch_and_add(&handling, 1);
+	__sync_fetch_and_add(&epoch, 1);
+	Sync::for_each(buf, [&](KeyType id, const WireType &value)
+	{
+		LocalId index = graph->local_index(id);
+		// nothing to apply when op keeps the accumulator
+		if(mesg_buf->accumulate(acc + index, value))
+			schedule(index, APPLY, index % COMP_THREADS);
+	});
+	free(buf);
+	__sync_fetch_and_add(&num_recv, 1);
+	__sync_fetch_and_sub(&handling, 1);
+	return true;
+}
+
+template<class KeyType, class ValueType, class WireType>
+inline bool AsyncEngine<KeyType, ValueType, WireType>::idle()
+{
+	if(pending || handling)
+		return false;
+	for (int i = 0; i < COMP_THREADS; ++i)
+		if(dirty[i])
+			return false;
+	return true;
+}
+
+/*
+	a rank joins the next wave with its counters only while it is idle and they are stable,
+	all ranks see the same reductions and stop at the same wave
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void AsyncEngine<KeyType, ValueType, WireType>::detect_termination()
+{
+	if(in_wave)
+	{
+		int flag;
+		MPI_Test(&wave_req, &flag, MPI_STATUS_IGNORE);
+		if(!flag)
+			return;
+		in_wave = false;
+		bool quiet = (wave[0] == wave[1] && wave[0] == last_wave[0] && wave[1] == last_wave[1]);
+		last_wave[0] = wave[0];
+		last_wave[1] = wave[1];
+		if(quiet && width > 0)
+			next_bucket();
+		else if(quiet)
+			done = true;
+		return;
+	}
+
+	unsigned long e = epoch;
+	if(!idle())
+		return;
+	unsigned long counters[2] = {num_sent, num_recv};
+	if(!idle() || e != epoch)
+		return;
+	MPI_Iallreduce(counters, wave, 2, MPI_UNSIGNED_LONG, MPI_SUM, comm->mpi_comm, &wave_req);
+	in_wave = true;
+}
+
+#endif
@@ -10,6 +10,7 @@ private:
 	size_t unit_len = sizeof(uint8_t);
 	size_t arr_index;
 	size_t bit_index;
+	uint8_t taken; // unit being scanned by take_next_bit
 public:
 	BitMap () {}
 
@@ -23,11 +24,16 @@ public:
 	{
 		num_bits = total_bits;
 		arr_len = int(total_bits / unit_len) + 1;
+		// again when the graph changes
+		if(array != NULL)
+			free(array);
 		array = (uint8_t *)malloc(arr_len * unit_len);
 		clear();
 	}
 	inline bool set_bit(size_t id);
+	inline bool get_bit(size_t id) const {return array[id / unit_len] & (1 << (id % unit_len));}
 	inline bool next_bit(size_t *id);
+	inline bool take_next_bit(size_t *id);
 	inline void clear();
 	inline size_t size();
 
@@ -70,6 +76,42 @@ inline bool BitMap::next_bit(size_t *id)
 			}
 		}
 	}
+	// the next scan starts over
+	arr_index = 0;
+	bit_index = 0;
+	return false;
+}
+
+/*
+	like next_bit, but clears each unit atomically as it is scanned, so a bit set concurrently
+	is either returned or left for the next scan, and the scan starts over once it is done
+*/
+inline bool BitMap::take_next_bit(size_t *id)
+{
+	for (; arr_index < arr_len; ++arr_index, bit_index = 0)
+	{
+		if(!bit_index)
+		{
+			if(!array[arr_index])
+				continue;
+			taken = __sync_fetch_and_and(array + arr_index, 0);
+		}
+		for (; bit_index < unit_len; ++bit_index)
+		{
+			if(1 & (taken >> bit_index))
+			{
+				*id = arr_index * unit_len + bit_index;
+				if(++bit_index == unit_len)
+				{
+					arr_index++;
+					bit_index = 0;
+				}
+				return true;
+			}
+		}
+	}
+	arr_index = 0;
+	bit_index = 0;
 	return false;
 }
 
@@ -109,4 +151,4 @@ inline size_t BitMap::size()
 		}
 	}
 	return count;
-}
\ No newline at end of file
+}
\ No newline at end of file
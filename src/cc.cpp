@@ -1,67 +1,15 @@
 
 #include "controller.hpp"
 #include "graph.hpp"
+#include "stream.hpp"
 #include "engine.hpp"
-#include "vertexprogram.hpp"
+#include "ssp_engine.hpp"
+#include "async_engine.hpp"
+#include "cc.hpp"
 #include <algorithm>
 #include <math.h>
 #include <unordered_map>
 
-template<class KeyType, class ValueType>
-class ConnectedComponent: public VertexProgram<KeyType, ValueType>
-{
-private:
-	ValueType delta = 0;
-	//ValueType change;
-	typedef Vertex<KeyType, ValueType> VertexType;
-public:
-	ConnectedComponent() {this->iterations = 32; this->acc_init = 1 << 30;}
-	~ConnectedComponent() {}
-
-	EDGE_DIRECTION gather_edge() {return ALL_EDGES;}
-	EDGE_DIRECTION gather_edge(VertexType &v) {return ALL_EDGES;}
-	EDGE_DIRECTION scatter_edge() {return ALL_EDGES;}
-	EDGE_DIRECTION scatter_edge(VertexType &v)
-	{
-		if(v.change)
-			return ALL_EDGES;
-		else
-			return NO_EDGES;
-	}
-
-	ValueType gather(VertexType &v, VertexType &nbr)
-	{
-		return nbr.get_value();
-	}
-
-	ValueType op(ValueType x, ValueType y)
-	{
-		return std::min(x, y);
-	}
-
-	void apply(VertexType &v, ValueType total)
-	{
-		ValueType old_value = v.get_value();
-		v.set_value(std::min(old_value, total));
-		v.change = v.get_value() - old_value;
-	}
-
-	bool scatter(VertexType &v, VertexType &nbr)
-	{
-		if(v.get_value() < nbr.get_value())
-			return true;
-		else
-			return false;
-	}
-	
-	static bool init_vertex(VertexType &v)
-	{
-		v.set_value(v.get_id());
-		return true;
-	}
-
-};
-
 template<class KeyType, class ValueType>
 ValueType op(ValueType x, ValueType y)
 {
@@ -86,7 +34,7 @@ void format_print(Vertex<KeyType, ValueType> &v, FILE* fp) {
 		um[v.get_value()] = idx++;
 	}
 
-	fprintf(fp, "  %d [front=white, color=%s]\n", v.get_id(), colors[um[v.get_value()]]);
+	fprintf(fp, "  %lu [front=white, color=%s]\n", (unsigned long)v.get_id(), colors[um[v.get_value()]]);
 }
 
 template<class KeyType, class ValueType>
@@ -110,10 +58,24 @@ int main(int argc, char *argv[])
 	int opt;
 	char *file_path = NULL;
 	size_t threshold = 1000;
+	int reorder_type = REORDER_NONE;
+	bool compressed = false;
+	bool weighted = false;
+	int id_bits = 32;
+	char *output = NULL;
+	int output_type = OUTPUT_TEXT;
+	char *checkpoint = NULL;
+	int period = 10;
+	bool restart = false;
+	char *prior = NULL;
+	char *updates = NULL;
+	char *feed = NULL;
+	bool async = false;
+	int staleness = -1;
 
 	char *outfile = NULL;
 
-    while ((opt = getopt(argc, argv, "g:t:p:")) != -1) {
+    while ((opt = getopt(argc, argv, "g:t:p:r:cwi:aS:o:O:W:U:F:C:P:R")) != -1) {
         switch (opt) {
         case 'g':
             file_path = optarg;
@@ -121,32 +83,127 @@ int main(int argc, char *argv[])
         case 't':
             threshold = (size_t)atoi(optarg);
             break;
+        case 'r':
+            reorder_type = atoi(optarg);
+            break;
+        case 'c':
+            compressed = true;
+            break;
+        case 'w':
+            weighted = true;
+            break;
+        case 'i':
+            id_bits = atoi(optarg);
+            break;
+        case 'a':
+            async = true;
+            break;
+        case 'S':
+            staleness = atoi(optarg);
+            break;
         case 'p':
         	outfile = optarg;
         	break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'O':
+            output_type = atoi(optarg);
+            break;
+        case 'C':
+            checkpoint = optarg;
+            break;
+        case 'P':
+            period = atoi(optarg);
+            break;
+        case 'R':
+            restart = true;
+            break;
+        case 'W':
+            prior = optarg;
+            break;
+        case 'U':
+            updates = optarg;
+            break;
+        case 'F':
+            feed = optarg;
+            break;
         default:
-            fprintf(stderr, "Usage: %s [-g graph] [-t threshold]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-r reorder] [-c] [-w] [-i id bits] [-a] [-S staleness] [-o output] [-O output type] [-W prior results] [-U edge updates] [-F edge stream] [-C checkpoint] [-P checkpoint period] [-R]\n", argv[0]);
             exit(EXIT_FAILURE);
         }
     }
 
 	if (file_path == NULL) {
-		fprintf(stderr, "Usage: %s [-g graph] [-t threshold]\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-r reorder] [-c] [-w] [-i id bits] [-a] [-S staleness] [-o output] [-O output type] [-W prior results] [-U edge updates] [-F edge stream] [-C checkpoint] [-P checkpoint period] [-R]\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
-	Controller<unsigned int, unsigned int> controller;
+	Controller<VertexId, VertexId> controller;
 
-	ConnectedComponent<unsigned int, unsigned int> connectedcomponent;
+	ConnectedComponent<VertexId, VertexId> connectedcomponent;
 	
-	Graph<unsigned int, unsigned int> graph(&controller, file_path, threshold, 1);
-	graph.transform_vertices(ConnectedComponent<unsigned int, unsigned int>::init_vertex);
+	Graph<VertexId, VertexId> graph(&controller, file_path, threshold, 1, reorder_type, compressed, weighted, id_bits);
+	graph.transform_vertices(ConnectedComponent<VertexId, VertexId>::init_vertex, prior);
 	
-	Engine<unsigned int, unsigned int> engine(&controller, &graph, &connectedcomponent);
-	engine.run();
+	auto run = [&]()
+	{
+		if(async)
+		{
+			AsyncEngine<VertexId, VertexId> engine(&controller, &graph, &connectedcomponent);
+			engine.run();
+		}
+		else if(staleness >= 0 && SspEngine<VertexId, VertexId>::supported(&controller, &connectedcomponent))
+		{
+			SspEngine<VertexId, VertexId> engine(&controller, &graph, &connectedcomponent, staleness);
+			engine.run();
+		}
+		else
+		{
+			Engine<VertexId, VertexId> engine(&controller, &graph, &connectedcomponent);
+			// only the run on the loaded graph is checkpointed
+			if(checkpoint)
+				engine.set_checkpoint(checkpoint, period, restart);
+			checkpoint = NULL;
+			engine.run();
+		}
+	};
+	run();
+
+	// then from the labels of the graph before the updates
+	if(updates)
+	{
+		std::vector<EdgeUpdate<VertexId> > batch;
+		if(0 == controller.comm->get_rank() && !read_updates(updates, batch))
+		{
+			fprintf(stderr, "Cannot read %s\n", updates);
+			MPI_Abort(controller.comm->mpi_comm, EXIT_FAILURE);
+		}
+		// labels only decrease, they are computed again once edges are deleted
+		if(graph.update_edges(batch, ConnectedComponent<VertexId, VertexId>::init_vertex))
+			graph.reset_vertices(ConnectedComponent<VertexId, VertexId>::init_vertex);
+		run();
+	}
+	// and round after round from the updates arriving on the stream, until it ends
+	if(feed)
+	{
+		EdgeStream<VertexId, VertexId> stream(&controller, &graph, feed);
+		std::vector<EdgeUpdate<VertexId> > batch;
+		while(stream.next(batch))
+		{
+			// labels only decrease, they are computed again once edges are deleted
+			if(graph.update_edges(batch, ConnectedComponent<VertexId, VertexId>::init_vertex))
+				graph.reset_vertices(ConnectedComponent<VertexId, VertexId>::init_vertex);
+			run();
+			stream.visible();
+		}
+	}
+
+	if(output)
+		graph.write_values(output, output_type);
 
 	if (outfile != NULL) {
-		show_cc<unsigned int, unsigned int>(graph, outfile);
+		show_cc<VertexId, VertexId>(graph, outfile);
 	}
 
 	return 0;
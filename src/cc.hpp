@@ -0,0 +1,66 @@
+#ifndef CONNECTED_COMPONENT
+#define CONNECTED_COMPONENT
+
+#include "vertexprogram.hpp"
+#include <algorithm>
+#include <limits>
+
+template<class KeyType, class ValueType>
+class ConnectedComponent: public VertexProgram<KeyType, ValueType>
+{
+private:
+	ValueType delta = 0;
+	//ValueType change;
+	typedef Vertex<KeyType, ValueType> VertexType;
+public:
+	ConnectedComponent() {this->iterations = 32; this->acc_init = std::numeric_limits<ValueType>::max();}
+	~ConnectedComponent() {}
+
+	EDGE_DIRECTION gather_edge() {return ALL_EDGES;}
+	EDGE_DIRECTION gather_edge(VertexType &v) {return ALL_EDGES;}
+	EDGE_DIRECTION scatter_edge() {return ALL_EDGES;}
+	EDGE_DIRECTION scatter_edge(VertexType &v)
+	{
+		if(v.get_change())
+			return ALL_EDGES;
+		else
+			return NO_EDGES;
+	}
+
+	ValueType gather(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		return nbr.get_value();
+	}
+
+	ValueType op(ValueType x, ValueType y)
+	{
+		return std::min(x, y);
+	}
+
+	// values only decrease, so reading a new value within the iteration only gets there sooner
+	bool fused_apply() {return true;}
+
+	void apply(VertexType &v, ValueType total)
+	{
+		ValueType old_value = v.get_value();
+		v.set_value(std::min(old_value, total));
+		v.set_change(v.get_value() - old_value);
+	}
+
+	bool scatter(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		if(v.get_value() < nbr.get_value())
+			return true;
+		else
+			return false;
+	}
+	
+	static bool init_vertex(VertexType &v)
+	{
+		v.set_value(v.get_id());
+		return true;
+	}
+
+};
+
+#endif
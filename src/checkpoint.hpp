@@ -0,0 +1,285 @@
+#ifndef CHECKPOINT
+#define CHECKPOINT
+
+#include <mpi.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+#include "graph.hpp"
+#include "aggregator.hpp"
+#include "serialize.hpp"
+
+/*
+	checkpoints of a run of Engine, every rank writes its own to path.rank.0 and path.rank.1 in turn
+	at the end of every period-th iteration, the state the next iteration starts from is copied into a buffer:
+	the id, active bit, value and change of every local vertex, the aggregators and the iteration
+	a thread of its own writes the buffer into a temporary file, renamed once complete, while the next iterations run
+	a checkpoint is copied only once every rank has written the last one, so while it is written the other file
+	of every rank holds the same complete checkpoint
+	a restart takes the latest iteration found in the files of all ranks, the graph must have been loaded
+	as for the checkpoint, with as many ranks and the same options, which the fingerprint of its local vertices checks,
+	their local order may differ, as it follows the arrival of the edges when they are not reordered
+*/
+template<class KeyType, class ValueType>
+class Checkpoint
+{
+private:
+	typedef Vertex<KeyType, ValueType> VertexType;
+	typedef Graph<KeyType, ValueType> GraphType;
+
+	struct Header
+	{
+		uint64_t magic;
+		int32_t iteration;
+		int32_t size;
+		uint64_t num_vertices;
+		uint64_t fingerprint;
+		uint64_t aggregator_bytes;
+		uint64_t bytes; // of the whole checkpoint, to tell a complete file
+	};
+	static const uint64_t MAGIC = 0x544e494f504b4843ULL;
+
+	Communicator *comm;
+	GraphType *graph;
+	std::string path;
+	int period;
+	int rank;
+	int size;
+	uint64_t fingerprint;
+
+	// header, aggregators, then id, active byte, value and change of every local vertex
+	std::vector<char> buffer;
+	std::vector<size_t> offset;
+	int iteration;
+	pthread_t writer;
+	bool writing = false;
+
+	int num_checkpoints = 0;
+	size_t num_bytes = 0;
+	double copy_time = 0;
+	double write_time = 0;
+	double wait_time = 0;
+
+	std::string file(int slot) {return path + "." + std::to_string(rank) + "." + std::to_string(slot);}
+	static void *write(void *arg);
+	void wait();
+	bool read_header(int slot, Header &header, size_t aggregator_bytes);
+
+public:
+	Checkpoint(Communicator *comm, GraphType *graph, const char *path, int period);
+	~Checkpoint() {wait();}
+
+	inline bool due(int iteration) const {return period > 0 && 0 == iteration % period;}
+	// copy the state at the end of the iteration before the given one and write it in the background, collective
+	void save(int iteration, std::vector<AggregatorBase *> &aggregators);
+	// the iteration of the last consistent checkpoint, whose state is restored, or -1 when there is none, collective
+	int restore(std::vector<AggregatorBase *> &aggregators);
+	// wait for the last checkpoint and report, collective
+	void finish();
+};
+
+template<class KeyType, class ValueType>
+Checkpoint<KeyType, ValueType>::Checkpoint(Communicator *comm, GraphType *graph, const char *path, int period):
+	comm(comm), graph(graph), path(path), period(period)
+{
+	rank = comm->get_rank();
+	size = comm->get_size();
+	// the ids of the local vertices in any order, and the number of edges
+	uint64_t sum = 0;
+	#pragma omp parallel for num_threads(COMP_THREADS) reduction(+:sum)
+	for(size_t i = 0; i < graph->local_vertex.size(); ++i)
+		sum += edge_hash(graph->local_vertex[i]->get_id(), 0, i < graph->ltov_low_master.size());
+	fingerprint = sum ^ graph->num_edges ^ ((uint64_t)size << 48);
+}
+
+template<class KeyType, class ValueType>
+void *Checkpoint<KeyType, ValueType>::write(void *arg)
+{
+	Checkpoint<KeyType, ValueType> *checkpoint = (Checkpoint<KeyType, ValueType> *)arg;
+	double start = MPI_Wtime();
+	std::string path = checkpoint->file(checkpoint->iteration / checkpoint->period % 2);
+	std::string tmp = path + ".tmp";
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	bool done = (NULL != fp);
+	if(fp)
+	{
+		done = (fwrite(checkpoint->buffer.data(), 1, checkpoint->buffer.size(), fp) == checkpoint->buffer.size());
+		done = !fflush(fp) && !fsync(fileno(fp)) && done;
+		done = !fclose(fp) && done;
+	}
+	if(!done || rename(tmp.c_str(), path.c_str()))
+		fprintf(stderr, "Cannot write checkpoint %s\n", path.c_str());
+	checkpoint->write_time += MPI_Wtime() - start;
+	return NULL;
+}
+
+template<class KeyType, class ValueType>
+void Checkpoint<KeyType, ValueType>::wait()
+{
+	if(!writing)
+		return;
+	pthread_join(writer, NULL);
+	writing = false;
+}
+
+template<class KeyType, class ValueType>
+void Checkpoint<KeyType, ValueType>::save(int iteration, std::vector<AggregatorBase *> &aggregators)
+{
+	TRACE_SCOPE("checkpoint");
+	double start = MPI_Wtime();
+	wait();
+	MPI_Barrier(comm->mpi_comm);
+	wait_time += MPI_Wtime() - start;
+
+	start = MPI_Wtime();
+	size_t num = graph->local_vertex.size();
+	size_t aggregator_bytes = 0;
+	for(auto aggregator : aggregators)
+		aggregator_bytes += aggregator->bytes();
+	offset.resize(num + 1);
+	offset[0] = sizeof(Header) + aggregator_bytes;
+	for (size_t i = 0; i < num; ++i)
+	{
+		VertexType *v = graph->local_vertex[i];
+		offset[i + 1] = offset[i] + sizeof(KeyType) + 1 + Serializer<ValueType>::size(v->get_value()) + Serializer<ValueType>::size(v->get_change());
+	}
+	buffer.resize(offset[num]);
+
+	Header header = {MAGIC, iteration, size, num, fingerprint, aggregator_bytes, offset[num]};
+	memcpy(buffer.data(), &header, sizeof(Header));
+	#pragma omp parallel for num_threads(COMP_THREADS)
+	for (size_t i = 0; i < num; ++i)
+	{
+		VertexType *v = graph->local_vertex[i];
+		char *ptr = buffer.data() + offset[i];
+		KeyType id = v->get_id();
+		memcpy(ptr, &id, sizeof(KeyType));
+		ptr[sizeof(KeyType)] = graph->get_active(i);
+		ptr = Serializer<ValueType>::pack(ptr + sizeof(KeyType) + 1, v->get_value());
+		Serializer<ValueType>::pack(ptr, v->get_change());
+	}
+	char *ptr = buffer.data() + sizeof(Header);
+	for(auto aggregator : aggregators)
+	{
+		aggregator->save(ptr);
+		ptr += aggregator->bytes();
+	}
+	copy_time += MPI_Wtime() - start;
+
+	this->iteration = iteration;
+	writing = true;
+	pthread_create(&writer, NULL, Checkpoint<KeyType, ValueType>::write, this);
+	num_checkpoints++;
+	num_bytes += buffer.size();
+}
+
+// the header of a complete checkpoint of this graph, false for any other file
+template<class KeyType, class ValueType>
+bool Checkpoint<KeyType, ValueType>::read_header(int slot, Header &header, size_t aggregator_bytes)
+{
+	FILE *fp = fopen(file(slot).c_str(), "rb");
+	if(!fp)
+		return false;
+	bool valid = (1 == fread(&header, sizeof(Header), 1, fp));
+	fseek(fp, 0, SEEK_END);
+	valid = valid && (uint64_t)ftell(fp) == header.bytes;
+	fclose(fp);
+	return valid && MAGIC == header.magic && size == header.size && graph->local_vertex.size() == header.num_vertices
+		&& fingerprint == header.fingerprint && aggregator_bytes == header.aggregator_bytes;
+}
+
+template<class KeyType, class ValueType>
+int Checkpoint<KeyType, ValueType>::restore(std::vector<AggregatorBase *> &aggregators)
+{
+	double start = MPI_Wtime();
+	size_t aggregator_bytes = 0;
+	for(auto aggregator : aggregators)
+		aggregator_bytes += aggregator->bytes();
+	Header header[2];
+	int found[2];
+	for (int slot = 0; slot < 2; ++slot)
+		found[slot] = read_header(slot, header[slot], aggregator_bytes) ? header[slot].iteration : -1;
+	std::vector<int> all(2 * size);
+	MPI_Allgather(found, 2, MPI_INT, all.data(), 2, MPI_INT, comm->mpi_comm);
+
+	// the latest iteration every rank has, which is one of those of this rank
+	int iteration = -1;
+	for (int slot = 0; slot < 2; ++slot)
+	{
+		bool everywhere = (found[slot] > iteration);
+		for (int r = 0; r < size && everywhere; ++r)
+			everywhere = (all[2 * r] == found[slot] || all[2 * r + 1] == found[slot]);
+		if(everywhere)
+			iteration = found[slot];
+	}
+	if(iteration < 0)
+	{
+		if(0 == rank)
+			printf("No checkpoint at %s, starting over\n", path.c_str());
+		return -1;
+	}
+
+	int slot = (found[0] == iteration) ? 0 : 1;
+	FILE *fp = fopen(file(slot).c_str(), "rb");
+	std::vector<char> data(header[slot].bytes);
+	if(!fp || 1 != fread(data.data(), data.size(), 1, fp))
+	{
+		fprintf(stderr, "Cannot read checkpoint %s\n", file(slot).c_str());
+		MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+	}
+	fclose(fp);
+
+	size_t num = graph->local_vertex.size();
+	const char *ptr = data.data() + sizeof(Header);
+	for(auto aggregator : aggregators)
+	{
+		aggregator->load(ptr);
+		ptr += aggregator->bytes();
+	}
+	graph->low_active_master.clear();
+	graph->low_active_mirror.clear();
+	graph->high_active_master.clear();
+	graph->high_active_mirror.clear();
+	for (size_t i = 0; i < num; ++i)
+	{
+		KeyType id;
+		LocalId index = 0;
+		memcpy(&id, ptr, sizeof(KeyType));
+		if(!graph->find_local(id, index))
+		{
+			fprintf(stderr, "Checkpoint %s does not match the graph\n", file(slot).c_str());
+			MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+		}
+		VertexType *v = graph->local_vertex[index];
+		bool active = ptr[sizeof(KeyType)];
+		ValueType value;
+		ptr = Serializer<ValueType>::unpack(ptr + sizeof(KeyType) + 1, value);
+		ptr = Serializer<ValueType>::unpack(ptr, v->get_change());
+		v->set_value(value);
+		v->set_active(active);
+		if(active)
+			graph->set_active(index);
+	}
+	if(0 == rank)
+		printf("Restart: %s, iteration: %d, time: %lf (s)\n", path.c_str(), iteration, MPI_Wtime() - start);
+	return iteration;
+}
+
+template<class KeyType, class ValueType>
+void Checkpoint<KeyType, ValueType>::finish()
+{
+	double start = MPI_Wtime();
+	wait();
+	wait_time += MPI_Wtime() - start;
+	double local[3] = {copy_time, write_time, wait_time}, global[3];
+	unsigned long bytes = num_bytes, total_bytes;
+	MPI_Reduce(local, global, 3, MPI_DOUBLE, MPI_MAX, 0, comm->mpi_comm);
+	MPI_Reduce(&bytes, &total_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
+	if(0 == rank && num_checkpoints)
+		printf("Checkpoints: %d, %lf (MB), copy time: %lf (s), write time: %lf (s), wait time: %lf (s)\n",
+			num_checkpoints, total_bytes / 1048576.0, global[0], global[1], global[2]);
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <string.h>
 #include "message.hpp"
+#include "trace.hpp"
 
 #include <sys/sysinfo.h>
 // number of threads
@@ -57,7 +58,8 @@ public:
 
 void Communicator::init()
 {
-	MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, NULL);
+	int provided;
+	MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &provided);
 	MPI_Comm_size(MPI_COMM_WORLD, &size);
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
@@ -76,6 +78,9 @@ void Communicator::recv_loop(bool &loop, int *tag, void **recv_buf)
 
 	while(!flag)
 	{
+		// set before probing: the probe matches the message, which completes its synchronous send, and a
+		// barrier passed on that must still see this thread receiving
+		receiving[thread_id] = 1;
 		MPI_Improbe(MPI_ANY_SOURCE, MPI_ANY_TAG, mpi_comm, &flag, &msg, &status);
 		receiving[thread_id] = flag;
 		if(!loop)
@@ -143,4 +148,4 @@ inline void Communicator::issend(int target_rank, int tag, void *buf, int size,
 }
 
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
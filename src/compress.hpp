@@ -0,0 +1,75 @@
+#ifndef COMPRESS
+#define COMPRESS
+
+#include <vector>
+#include <stdint.h>
+
+/*
+	compressed neighbor list
+	sorted local indexes, stored as deltas in byte-aligned varint (7 bits per byte,
+	the high bit marks a following byte), decoded on the fly
+*/
+class CompressedList
+{
+private:
+	std::vector<uint8_t> bytes;
+	uint32_t num = 0;
+
+public:
+	CompressedList() {}
+	~CompressedList() {}
+
+	inline void encode(std::vector<uint32_t> &indexes);
+	template<class Func>
+	inline void for_each(Func f) const;
+
+	inline size_t size() const {return num;}
+	inline size_t memory() const {return bytes.capacity();}
+};
+
+// indexes must be sorted
+inline void CompressedList::encode(std::vector<uint32_t> &indexes)
+{
+	bytes.clear();
+	uint32_t last = 0;
+	for(auto index : indexes)
+	{
+		uint32_t delta = index - last;
+		last = index;
+		while(delta >= 0x80)
+		{
+			bytes.push_back((uint8_t)(delta | 0x80));
+			delta >>= 7;
+		}
+		bytes.push_back((uint8_t)delta);
+	}
+	bytes.shrink_to_fit();
+	num = indexes.size();
+}
+
+template<class Func>
+inline void CompressedList::for_each(Func f) const
+{
+	const uint8_t *ptr = bytes.data();
+	uint32_t index = 0;
+	for (uint32_t i = 0; i < num; ++i)
+	{
+		uint32_t delta = *ptr++;
+		if(delta & 0x80)
+		{
+			delta &= 0x7f;
+			int shift = 7;
+			uint8_t byte;
+			do
+			{
+				byte = *ptr++;
+				delta |= (uint32_t)(byte & 0x7f) << shift;
+				shift += 7;
+			}while(byte & 0x80);
+		}
+		index += delta;
+		f(index);
+	}
+}
+
+#endif
@@ -21,6 +21,7 @@ public:
 	{
 		comm = new Communicator();
 		comm->init();
+		TRACE_INIT(comm->mpi_comm);
 
 		mesg_buf = new MessageBuffer<KeyType, ValueType>(comm->get_rank());
 		worker = new Worker<KeyType, ValueType>(comm, mesg_buf);
@@ -30,6 +31,8 @@ public:
 	}
 	~Controller()
 	{
+		// before the worker is stopped, which ends the process, no message is left to process by then
+		TRACE_WRITE(comm->mpi_comm);
 		worker->stop();
 		pthread_join(worker_thread, NULL);
 		delete worker;
@@ -3,18 +3,24 @@
 #define ENGINE
 
 #include <mpi.h>
+#include <mutex>
+#include <climits>
+#include <type_traits>
 #include "vertexprogram.hpp"
 #include "sender.hpp"
+#include "checkpoint.hpp"
 
 // #define SKIP_SCATTER
 
-template<class KeyType, class ValueType>
-class Engine
+template<class KeyType, class ValueType, class WireType = ValueType>
+class Engine: public MesgHandler
 {
-private:
+protected:
 	typedef Vertex<KeyType, ValueType> VertexType;
 	typedef Controller<KeyType, ValueType> ControllerType;
 	typedef MessageBuffer<KeyType, ValueType> MesgBuf;
+	typedef typename MesgBuf::template Sync<WireType> Sync;
+	typedef typename Sync::Mesg SyncMesg;
 	typedef Graph<KeyType, ValueType> GraphType;
 	typedef VertexProgram<KeyType, ValueType> VertexProgType;
 
@@ -27,10 +33,10 @@ private:
 	VertexProgType *v_prog;
 
 
-	std::pair<KeyType, KeyType*> low_master_active_array;
-	std::pair<KeyType, KeyType*> low_mirror_active_array;
-	std::pair<KeyType, KeyType*> high_master_active_array;
-	std::pair<KeyType, KeyType*> high_mirror_active_array;
+	std::pair<LocalId, LocalId*> low_master_active_array;
+	std::pair<LocalId, LocalId*> low_mirror_active_array;
+	std::pair<LocalId, LocalId*> high_master_active_array;
+	std::pair<LocalId, LocalId*> high_mirror_active_array;
 
 	
 
@@ -40,9 +46,49 @@ private:
 	double gather_comm_time = 0;
 	double apply_comm_time = 0;
 	double scatter_comm_time = 0;
-
-	KeyType *num_in_edges = new KeyType[COMP_THREADS];
-	KeyType *num_out_edges = new KeyType[COMP_THREADS];
+	double gather_comp_time = 0;
+	unsigned long num_updates = 0; // applies of this rank
+
+	// contribution of every local vertex in the order of Graph::local_vertex, for a dense gather
+	ValueType *contrib = NULL;
+	// gathered value of every local vertex in the same order and whether it is valid yet, for delta caching
+	ValueType *cache = NULL;
+	bool *cached = NULL;
+	// apply the masters without mirrors right after gathering them, see VertexProgram::fused_apply
+	bool fused;
+
+	// partials still expected by every master in the superstep mode, counting its own gather
+	int *pending_low = NULL;
+	int *pending_high = NULL;
+	// masters whose partials have all arrived, in the order they did, as (local id << 1 | high) + 1, 0 when not yet there
+	volatile uint64_t *ready = NULL;
+	volatile size_t ready_head = 0;
+	volatile size_t ready_tail = 0;
+	size_t num_to_apply = 0;
+	// values for the mirrors are held back while the local gathers may still read the old ones
+	bool gathering = false;
+	std::mutex defer_lock;
+	std::vector<std::pair<int, void *> > deferred;
+
+	// priority scheduling, off when the width is not positive, see VertexProgram::bucket_width
+	double width;
+	long bucket = 0; // the bucket being applied
+	static const long NO_BUCKET = LONG_MAX;
+	long *postponed_bucket = NULL; // bucket of every postponed master at Vertex::index, NO_BUCKET when not postponed
+	std::vector<VertexType *> *postponed = NULL; // per computing thread, may still hold masters applied since
+	char *listed = NULL; // masters in one of the lists above, at Vertex::index
+	char *heavy = NULL; // replicas whose heavy edges are left to scatter, at Vertex::index
+	std::vector<VertexType *> *heavy_replicas = NULL; // per computing thread
+	unsigned long *num_postponed = NULL; // applies postponed by every computing thread
+	int num_buckets = 0;
+
+	// checkpoints of the superstep mode, NULL without, see Checkpoint
+	Checkpoint<KeyType, ValueType> *checkpoint = NULL;
+	bool restart = false;
+	inline int resume();
+
+	unsigned long *num_in_edges = new unsigned long[COMP_THREADS];
+	unsigned long *num_out_edges = new unsigned long[COMP_THREADS];
 
 	typedef enum
 	{
@@ -52,27 +98,69 @@ private:
 		HIGH_MIRROR = 3
 	} VTYPE;
 
-	inline void bitmap_to_array(BitMap &active_set, std::pair<KeyType, KeyType*> &active_array);
+	inline void bitmap_to_array(BitMap &active_set, std::pair<LocalId, LocalId*> &active_array);
 	inline void bitmap_to_array_all();
 
 	inline void execute_gather();
-	inline void engine_gather_master(std::pair<KeyType, KeyType*> active_array, VTYPE type);
-	inline void engine_gather_mirror(std::pair<KeyType, KeyType*> active_array, VTYPE type);
+	inline void engine_gather_master(std::pair<LocalId, LocalId*> active_array, VTYPE type);
+	inline void engine_gather_mirror(std::pair<LocalId, LocalId*> active_array, VTYPE type, Sender<SyncMesg> *sender[]);
+	virtual void prepare_gather();
+	virtual void end_gather();
+	virtual void contribute(bool high, LocalId lid);
+	inline ValueType gather_vertex(VertexType *v);
+	inline ValueType gather_nbrs(VertexType *v);
+	inline void post_delta(VertexType *v);
+	inline void compute_contrib();
 
 	inline void execute_apply();
-	inline void engine_apply(std::pair<KeyType, KeyType*> active_array, VTYPE type, Sender<typename MesgBuf::SyncMesg> *sender[]);
+	virtual void apply_masters(Sender<SyncMesg> *sender_low[], Sender<SyncMesg> *sender_high[]);
+	inline void apply_ready(Sender<SyncMesg> *sender_low[], Sender<SyncMesg> *sender_high[]);
+	inline void apply_master(VertexType *v, ValueType total, Sender<SyncMesg> *sender);
 
 	inline void execute_scatter();
-	inline void engine_scatter(std::pair<KeyType, KeyType*> active_array, VTYPE type, Sender<typename MesgBuf::ActMesg> *sender[]);
-
-
-	inline void gather_apply();
+	inline void engine_scatter(std::pair<LocalId, LocalId*> active_array, VTYPE type, Sender<typename MesgBuf::ActMesg> *sender[]);
+	inline void scatter_vertex(VertexType *v, EDGE_DIRECTION edges, bool heavy_pass, Sender<typename MesgBuf::ActMesg> *sender);
+
+	inline bool postpone(VertexType *v, ValueType total);
+	inline unsigned long next_bucket();
+	inline void report(double start);
+
+	/*
+		the hooks of the stale synchronous mode, see SspEngine
+	*/
+	// tags of the mirror partials and of the values for the mirrors
+	virtual int partial_tag(bool high) {return high ? SYNC_MASTER_HIGH : SYNC_MASTER_LOW;}
+	virtual int value_tag(bool high) {return high ? SYNC_MIRROR_HIGH : SYNC_MIRROR_LOW;}
+	// the barrier that closes a phase of an iteration, and what the other computing threads do meanwhile
+	virtual void barrier()
+	{
+		TRACE_SCOPE("barrier");
+		MPI_Barrier(comm->mpi_comm);
+	}
+	virtual void receive_until_barrier()
+	{
+		while(comm->is_receiving())
+			irecv();
+	}
+	virtual bool next_active(BitMap &active_set, size_t *id) {return active_set.next_bit(id);}
+	// the names of the vertex classes on the timeline, see trace.hpp, by phase: 0 gather, 1 apply, 2 scatter
+	static const char *trace_name(int phase, VTYPE type)
+	{
+		static const char *const names[3][4] = {
+			{"gather low master", "gather low mirror", "gather high master", "gather high mirror"},
+			{"apply low master", "apply low mirror", "apply high master", "apply high mirror"},
+			{"scatter low master", "scatter low mirror", "scatter high master", "scatter high mirror"}};
+		return names[phase][type];
+	}
 
 	inline void irecv();
 
 public:
-	Engine(ControllerType *controller, GraphType *graph, VertexProgType *v_prog):controller(controller), graph(graph), v_prog(v_prog)
+	// WireType is that of the program, e.g. Engine<VertexId, double, PageRank<VertexId, double>::WireType>
+	template<class ProgType>
+	Engine(ControllerType *controller, GraphType *graph, ProgType *v_prog):controller(controller), graph(graph), v_prog(v_prog)
 	{
+		static_assert(std::is_same<WireType, typename ProgType::WireType>::value, "the engine must send the wire type of the program");
 		comm = controller->comm;
 		rank = comm->get_rank();
 		mpi_size = comm->get_size();
@@ -81,15 +169,48 @@ public:
 		acc_init = v_prog->acc_init;
 
 		mesg_buf->init(graph, v_prog);
-
-		low_master_active_array.second =  new KeyType[graph->low_degree_master.size()];
-		low_mirror_active_array.second =  new KeyType[graph->low_degree_mirror.size()];
-		high_master_active_array.second = new KeyType[graph->high_degree_master.size()];
-		high_mirror_active_array.second = new KeyType[graph->high_degree_mirror.size()];
+		mesg_buf->handler = this;
+		width = v_prog->bucket_width();
+		pending_low = new int[graph->low_degree_master.size()]();
+		pending_high = new int[graph->high_degree_master.size()]();
+		ready = new uint64_t[graph->low_degree_master.size() + graph->high_degree_master.size()]();
+
+		low_master_active_array.second =  new LocalId[graph->low_degree_master.size()];
+		low_mirror_active_array.second =  new LocalId[graph->low_degree_mirror.size()];
+		high_master_active_array.second = new LocalId[graph->high_degree_master.size()];
+		high_mirror_active_array.second = new LocalId[graph->high_degree_mirror.size()];
 		bitmap_to_array_all();
+
+		if(v_prog->dense_gather())
+			contrib = new ValueType[graph->local_vertex.size()];
+		fused = v_prog->fused_apply();
+
+		if(v_prog->delta_cache())
+		{
+			cache = new ValueType[graph->local_vertex.size()];
+			cached = new bool[graph->local_vertex.size()]();
+			std::fill(graph->vertex_state.change.begin(), graph->vertex_state.change.end(), ValueType());
+		}
+
+		if(width > 0)
+		{
+			postponed_bucket = new long[graph->local_vertex.size()];
+			std::fill(postponed_bucket, postponed_bucket + graph->local_vertex.size(), NO_BUCKET);
+			postponed = new std::vector<VertexType *>[COMP_THREADS];
+			listed = new char[graph->local_vertex.size()]();
+			heavy = new char[graph->local_vertex.size()]();
+			heavy_replicas = new std::vector<VertexType *>[COMP_THREADS];
+			num_postponed = new unsigned long[COMP_THREADS]();
+		}
+
+		for(auto aggregator : v_prog->aggregators)
+			aggregator->init(COMP_THREADS);
+		prepare_gather();
 	}
 	~Engine()
 	{
+		if(this == mesg_buf->handler)
+			mesg_buf->handler = NULL;
 		delete num_in_edges;
 		delete num_out_edges;
 
@@ -97,18 +218,68 @@ public:
 		delete low_mirror_active_array.second;
 		delete high_master_active_array.second;
 		delete high_mirror_active_array.second;
+		delete []contrib;
+		delete []cache;
+		delete []cached;
+		delete []pending_low;
+		delete []pending_high;
+		delete []ready;
+		delete []postponed_bucket;
+		delete []postponed;
+		delete []listed;
+		delete []heavy;
+		delete []heavy_replicas;
+		delete []num_postponed;
+		delete checkpoint;
 	}
 
+	// write a checkpoint every period iterations to path.rank, with restart the run resumes from the last one
+	void set_checkpoint(const char *path, int period, bool restart = false);
 	void run();
+	bool process_mesg(int tag, void *buf);
 };
 
-template<class KeyType, class ValueType>
-void Engine<KeyType, ValueType>::run()
+template<class KeyType, class ValueType, class WireType>
+void Engine<KeyType, ValueType, WireType>::set_checkpoint(const char *path, int period, bool restart)
+{
+	// the postponed masters are not kept
+	if(width > 0)
+	{
+		if(0 == rank)
+			printf("Checkpoints not supported here, running without\n");
+		return;
+	}
+	delete checkpoint;
+	checkpoint = new Checkpoint<KeyType, ValueType>(comm, graph, path, period);
+	this->restart = restart;
+}
+
+/*
+	the state of the last checkpoint in place of the one the engine was built with, and its iteration
+	the masters to gather are prepared again, those that no longer are must not wait for partials
+*/
+template<class KeyType, class ValueType, class WireType>
+inline int Engine<KeyType, ValueType, WireType>::resume()
+{
+	int iteration = checkpoint->restore(v_prog->aggregators);
+	if(iteration < 0)
+		return 0;
+	memset(pending_low, 0, sizeof(int) * graph->low_degree_master.size());
+	memset(pending_high, 0, sizeof(int) * graph->high_degree_master.size());
+	bitmap_to_array_all();
+	prepare_gather();
+	return iteration;
+}
+
+template<class KeyType, class ValueType, class WireType>
+void Engine<KeyType, ValueType, WireType>::run()
 {
 	int i = 0;
 	bool conversed = false;
-	KeyType local_active;
-	KeyType global_active;
+	unsigned long local_active;
+	unsigned long global_active;
+	if(checkpoint && restart)
+		i = resume();
 	MPI_Barrier(comm->mpi_comm);
 	double start = MPI_Wtime();
 	double s = MPI_Wtime();
@@ -116,82 +287,177 @@ void Engine<KeyType, ValueType>::run()
 	{
 		start = MPI_Wtime();
 		execute_gather();
-		MPI_Barrier(comm->mpi_comm);
 		log("gather time: %lf\n", MPI_Wtime() - start);
 		start = MPI_Wtime();
 
 		execute_apply();
-		MPI_Barrier(comm->mpi_comm);
+		for(auto aggregator : v_prog->aggregators)
+			aggregator->start(comm->mpi_comm);
+		barrier();
 		log("apply time: %lf\n", MPI_Wtime() - start);
 		start = MPI_Wtime();
 
 		execute_scatter();
 		log("scatter time: %lf\n", MPI_Wtime() - start);
 		
-		MPI_Barrier(comm->mpi_comm);
+		barrier();
 
 		local_active = (graph->low_active_master).size() + (graph->high_active_master).size();
-		MPI_Allreduce(&local_active, &global_active, 1, MPI_INT, MPI_SUM, comm->mpi_comm);
-		log("Rank: %d, local active vertices: %d, LOW: %d, HIGH:%d\n", rank, local_active, (graph->low_active_master).size(), (graph->high_active_master).size());
+		TRACE_SCOPE("terminate");
+		MPI_Allreduce(&local_active, &global_active, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm->mpi_comm);
+		log("Rank: %d, local active vertices: %lu, LOW: %lu, HIGH:%lu\n", rank, local_active, (graph->low_active_master).size(), (graph->high_active_master).size());
 		if(0 == rank)
-			printf("Iteration: %d, global_active vertices: %d\n", i, global_active);
-		if(!global_active)
+			printf("Iteration: %d, global_active vertices: %lu\n", i, global_active);
+		for(auto aggregator : v_prog->aggregators)
+			aggregator->finish();
+		if(!global_active && width > 0)
+			global_active = next_bucket();
+		if(!global_active || v_prog->terminate())
 			conversed = true;
 		i++;
+		if(checkpoint && !conversed && i < max_iterations && checkpoint->due(i))
+			checkpoint->save(i, v_prog->aggregators);
 	}
+	if(checkpoint)
+		checkpoint->finish();
+	report(s);
+}
+
+// the statistics of a run started at start
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::report(double start)
+{
 	printf("Rank: %d, GAS (G: %lf, A: %lf, S: %lf, Total: %lf)\n", rank, gather_comm_time, apply_comm_time, scatter_comm_time, gather_comm_time+apply_comm_time+scatter_comm_time);
+	printf("Rank: %d, gather compute time: %lf (s)\n", rank, gather_comp_time);
+	unsigned long local_postponed = 0, global_postponed = 0;
+	if(width > 0)
+		for (int i = 0; i < COMP_THREADS; ++i)
+			local_postponed += num_postponed[i];
+	num_updates -= local_postponed;
+	unsigned long global_updates;
+	MPI_Reduce(&num_updates, &global_updates, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
+	MPI_Reduce(&local_postponed, &global_postponed, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
 	MPI_Barrier(comm->mpi_comm);
 	if (rank == 0) {
-		printf("Total computing time: %lf (s)\n", MPI_Wtime() - s);	
+		if(width > 0)
+			printf("Buckets: %d, postponed applies: %lu\n", num_buckets, global_postponed);
+		printf("Total vertex updates: %lu\n", global_updates);
+		printf("Total computing time: %lf (s)\n", MPI_Wtime() - start);
 	}
+}
 
+/*
+	messages processed by the engine instead of the MessageBuffer, in the worker threads
+	the partials that complete a master make it ready to apply, and the values for the mirrors are deferred
+	during the local gathers
+*/
+template<class KeyType, class ValueType, class WireType>
+bool Engine<KeyType, ValueType, WireType>::process_mesg(int tag, void *buf)
+{
+	switch(tag)
+	{
+		case SYNC_MASTER_LOW:
+		case SYNC_MASTER_HIGH:
+		{
+			bool high = (SYNC_MASTER_HIGH == tag);
+			ValueType *local_buf = high ? mesg_buf->get_sync_buf_high() : mesg_buf->get_sync_buf_low();
+			Sync::for_each(buf, [&](KeyType id, const WireType &value)
+			{
+				LocalId lid = high ? graph->gtol_high_master[id] : graph->gtol_low_master[id];
+				mesg_buf->accumulate(local_buf + lid, value);
+				contribute(high, lid);
+			});
+			free(buf);
+			return true;
+		}
+		case SYNC_MIRROR_LOW:
+		case SYNC_MIRROR_HIGH:
+		{
+			{
+				std::lock_guard<std::mutex> lock(defer_lock);
+				if(gathering)
+				{
+					deferred.push_back(std::make_pair(tag, buf));
+					return true;
+				}
+			}
+			auto &mirrors = (SYNC_MIRROR_HIGH == tag) ? graph->high_degree_mirror : graph->low_degree_mirror;
+			Sync::for_each(buf, [&](KeyType id, const WireType &value)
+			{
+				VertexType &v = mirrors.find(id)->second;
+				ValueType old_value = v.get_value();
+				v.set_value(value);
+				v.set_change(v.get_value() - old_value);
+			});
+			free(buf);
+			return true;
+		}
+		default: return false;
+	}
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::gather_apply()
+/*
+	the mirrors gather first and their partials go out block by block as they fill, the last blocks are flushed
+	while the masters gather, and the masters are applied as their partials complete, see execute_apply
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::execute_gather()
 {
+	TRACE_SCOPE("gather");
+	memset(num_in_edges, 0, sizeof(unsigned long) * COMP_THREADS);
+	memset(num_out_edges, 0, sizeof(unsigned long) * COMP_THREADS);
 
-	engine_gather_master(low_master_active_array, LOW_MASTER);
-	MPI_Barrier(comm->mpi_comm);
-	engine_gather_mirror(low_mirror_active_array, LOW_MIRROR);
-	MPI_Barrier(comm->mpi_comm);
-	while(comm->is_receiving());
-	engine_apply(low_master_active_array, LOW_MASTER);
-	MPI_Barrier(comm->mpi_comm);
-	while(comm->is_receiving());
-	
-	engine_gather_master(high_master_active_array, HIGH_MASTER);
-	MPI_Barrier(comm->mpi_comm);
-	engine_gather_mirror(high_mirror_active_array, HIGH_MIRROR);
-	MPI_Barrier(comm->mpi_comm);
-	while(comm->is_receiving());
-	engine_apply(high_master_active_array, HIGH_MASTER);
-	MPI_Barrier(comm->mpi_comm);
-	while(comm->is_receiving());
+	if(contrib)
+		compute_contrib();
 
-	double clear = MPI_Wtime();
-	graph->low_active_master.clear();
-	graph->low_active_mirror.clear();
-	graph->high_active_master.clear();
-	graph->high_active_mirror.clear();
-	log("clear time of apply: %lf\n", MPI_Wtime() - clear);
+	Sender<SyncMesg> *sender_low[COMP_THREADS];
+	Sender<SyncMesg> *sender_high[COMP_THREADS];
+	for (int i = 0; i < COMP_THREADS; ++i)
+	{
+		sender_low[i] = new Sender<SyncMesg>(comm, partial_tag(false));
+		sender_high[i] = new Sender<SyncMesg>(comm, partial_tag(true));
+	}
+	engine_gather_mirror(low_mirror_active_array, LOW_MIRROR, sender_low);
+	engine_gather_mirror(high_mirror_active_array, HIGH_MIRROR, sender_high);
 
-	bitmap_to_array_all();
+	double start = MPI_Wtime();
+	#pragma omp parallel num_threads(COMP_THREADS)
+	{
+		#pragma omp single nowait
+		{
+			for (int i = 0; i < COMP_THREADS; ++i)
+			{
+				sender_low[i]->flush();
+				delete sender_low[i];
+				sender_high[i]->flush();
+				delete sender_high[i];
+			}
+		}
+		engine_gather_master(low_master_active_array, LOW_MASTER);
+		engine_gather_master(high_master_active_array, HIGH_MASTER);
+	}
+	gather_comp_time += MPI_Wtime() - start;
+	log("MASTER gather Time: %lf\n", MPI_Wtime() - start);
+	end_gather();
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::execute_gather()
+/*
+	nothing reads the old values any more, so the values held back for the mirrors are taken,
+	and the active vertices have all been gathered
+*/
+template<class KeyType, class ValueType, class WireType>
+void Engine<KeyType, ValueType, WireType>::end_gather()
 {
-	memset(num_in_edges, 0, sizeof(KeyType) * COMP_THREADS);
-	memset(num_out_edges, 0, sizeof(KeyType) * COMP_THREADS);
-
-	
-	
-	engine_gather_master(low_master_active_array, LOW_MASTER);
-	engine_gather_master(high_master_active_array, HIGH_MASTER);
-	MPI_Barrier(comm->mpi_comm);
-	engine_gather_mirror(low_mirror_active_array, LOW_MIRROR);
-	engine_gather_mirror(high_mirror_active_array, HIGH_MIRROR);
+	std::vector<std::pair<int, void *> > values;
+	{
+		std::lock_guard<std::mutex> lock(defer_lock);
+		gathering = false;
+		values.swap(deferred);
+	}
+	TRACE_SCOPE("process deferred messages");
+	#pragma omp parallel for num_threads(COMP_THREADS)
+	for (size_t i = 0; i < values.size(); ++i)
+		mesg_buf->process_mesg(values[i].first, values[i].second);
 
 	// double clear = MPI_Wtime();
 	graph->low_active_master.clear();
@@ -199,28 +465,79 @@ inline void Engine<KeyType, ValueType>::execute_gather()
 	graph->high_active_master.clear();
 	graph->high_active_mirror.clear();
 	// log("clear time of gather: %lf\n", MPI_Wtime() - clear);
+}
 
-	// double wait = MPI_Wtime();
-	// MPI_Barrier(comm->mpi_comm);
-	while(comm->is_receiving());
-	// log("gather Wait time: %lf\n", MPI_Wtime() - wait);
+/*
+	reset the accumulators of the masters about to gather and count the partials they expect, before any rank
+	can send them one, and hold back the values for the mirrors until the local gathers are done
+	every active master has all its mirrors active, which send one partial each unless they have no edge to gather
+*/
+template<class KeyType, class ValueType, class WireType>
+void Engine<KeyType, ValueType, WireType>::prepare_gather()
+{
+	TRACE_SCOPE("prepare gather");
+	num_to_apply = 0;
+	ready_head = 0;
+	ready_tail = 0;
+	auto prepare = [&](std::pair<LocalId, LocalId*> &active_array, VTYPE type)
+	{
+		LocalId array_size = active_array.first;
+		LocalId *array = active_array.second;
+		ValueType *local_buf = (LOW_MASTER == type) ? mesg_buf->get_sync_buf_low() : mesg_buf->get_sync_buf_high();
+		int *pending = (LOW_MASTER == type) ? pending_low : pending_high;
+		bool mirror_partials = (HIGH_MASTER == type) || (IN_EDGES != v_prog->gather_edge());
+		size_t count = 0;
+		#pragma omp parallel for num_threads(COMP_THREADS) reduction(+:count)
+		for (LocalId i = 0; i < array_size; ++i)
+		{
+			LocalId lid = array[i];
+			VertexType *v = (LOW_MASTER == type) ? graph->ltov_low_master[lid] : graph->ltov_high_master[lid];
+			local_buf[lid] = acc_init;
+			if(fused && !v->replicated)
+				continue;
+			int expected = 1;
+			auto pair_it = (graph->mirror).find(v->get_id());
+			if(mirror_partials && (graph->mirror).end() != pair_it)
+				expected += pair_it->second.size();
+			pending[lid] = expected;
+			count++;
+		}
+		num_to_apply += count;
+	};
+	prepare(low_master_active_array, LOW_MASTER);
+	prepare(high_master_active_array, HIGH_MASTER);
+	gathering = true;
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::execute_apply()
+/*
+	one of the partials expected by a master has been accumulated, it is ready once they all are
+	the masters that are not active get partials of spurious activations only, which leave them below zero
+*/
+template<class KeyType, class ValueType, class WireType>
+void Engine<KeyType, ValueType, WireType>::contribute(bool high, LocalId lid)
 {
-	Sender<typename MesgBuf::SyncMesg> *sender_low[COMP_THREADS];
-	Sender<typename MesgBuf::SyncMesg> *sender_high[COMP_THREADS];
+	int *pending = high ? pending_high : pending_low;
+	if(__sync_sub_and_fetch(pending + lid, 1))
+		return;
+	size_t i = __sync_fetch_and_add(&ready_tail, 1);
+	ready[i] = ((uint64_t)lid << 1 | high) + 1;
+}
+
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::execute_apply()
+{
+	TRACE_SCOPE("apply");
+	Sender<SyncMesg> *sender_low[COMP_THREADS];
+	Sender<SyncMesg> *sender_high[COMP_THREADS];
 	for (int i = 0; i < COMP_THREADS; ++i)
 	{
-		sender_low[i] = new Sender<typename MesgBuf::SyncMesg>(comm, SYNC_MIRROR_LOW);
-		sender_high[i] = new Sender<typename MesgBuf::SyncMesg>(comm, SYNC_MIRROR_HIGH);
+		sender_low[i] = new Sender<SyncMesg>(comm, value_tag(false));
+		sender_high[i] = new Sender<SyncMesg>(comm, value_tag(true));
 	}
-
-	engine_apply(low_master_active_array, LOW_MASTER, sender_low);
-	engine_apply(high_master_active_array, HIGH_MASTER, sender_high);
+	apply_masters(sender_low, sender_high);
 
 	double start = MPI_Wtime();
+	TRACE_SCOPE("apply wait");
 	#pragma omp parallel num_threads(COMP_THREADS)
 	{
 		if(0 == omp_get_thread_num())
@@ -232,12 +549,12 @@ inline void Engine<KeyType, ValueType>::execute_apply()
 				sender_high[i]->flush();
 				delete sender_high[i];
 			}
-			MPI_Barrier(comm->mpi_comm);
+			barrier();
 		}
 		else
 		{
-			while(comm->is_receiving())
-				irecv();
+			// without the barrier other ranks may keep sending, and their messages are left to the workers
+			receive_until_barrier();
 		}
 	}
 
@@ -251,9 +568,53 @@ inline void Engine<KeyType, ValueType>::execute_apply()
 	// log("apply Wait time: %lf\n", MPI_Wtime() - wait);
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::execute_scatter()
+template<class KeyType, class ValueType, class WireType>
+void Engine<KeyType, ValueType, WireType>::apply_masters(Sender<SyncMesg> *sender_low[], Sender<SyncMesg> *sender_high[])
+{
+	double start = MPI_Wtime();
+	num_updates += low_master_active_array.first + high_master_active_array.first;
+	#pragma omp parallel num_threads(COMP_THREADS)
+	apply_ready(sender_low, sender_high);
+	log("Apply update time: %lf\n", MPI_Wtime() - start);
+}
+
+/*
+	apply the masters in the order their partials complete, receiving the missing ones meanwhile
+	called by every thread of a parallel region, the time the first one waits counts as gather communication
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::apply_ready(Sender<SyncMesg> *sender_low[], Sender<SyncMesg> *sender_high[])
 {
+	TRACE_SCOPE("apply ready");
+	int thread_id = omp_get_thread_num();
+	ValueType *buf_low = mesg_buf->get_sync_buf_low();
+	ValueType *buf_high = mesg_buf->get_sync_buf_high();
+	size_t i;
+	while((i = __sync_fetch_and_add(&ready_head, 1)) < num_to_apply)
+	{
+		uint64_t entry = ready[i];
+		if(!entry)
+		{
+			double start = MPI_Wtime();
+			while(!(entry = ready[i]))
+				irecv();
+			if(0 == thread_id)
+				gather_comm_time += MPI_Wtime() - start;
+		}
+		ready[i] = 0;
+		__sync_synchronize();
+		LocalId lid = (entry - 1) >> 1;
+		if((entry - 1) & 1)
+			apply_master(graph->ltov_high_master[lid], buf_high[lid], sender_high[thread_id]);
+		else
+			apply_master(graph->ltov_low_master[lid], buf_low[lid], sender_low[thread_id]);
+	}
+}
+
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::execute_scatter()
+{
+	TRACE_SCOPE("scatter");
 	Sender<typename MesgBuf::ActMesg> *sender[COMP_THREADS];
 	for (int i = 0; i < COMP_THREADS; ++i)
 		sender[i] = new Sender<typename MesgBuf::ActMesg>(comm, ACT);
@@ -291,6 +652,7 @@ inline void Engine<KeyType, ValueType>::execute_scatter()
 		engine_scatter(high_mirror_active_array, HIGH_MIRROR, sender);
 	}
 	double start = MPI_Wtime();
+	TRACE_SCOPE("scatter wait");
 	// volatile bool is_receiving = true;
 	#pragma omp parallel num_threads(COMP_THREADS)
 	{
@@ -301,13 +663,12 @@ inline void Engine<KeyType, ValueType>::execute_scatter()
 				sender[i]->flush();
 				delete sender[i];
 			}
-			MPI_Barrier(comm->mpi_comm);
+			barrier();
 			// is_receiving = false;
 		}
 		else
 		{
-			while(comm->is_receiving())
-				irecv();
+			receive_until_barrier();
 		}
 	}
 
@@ -318,127 +679,51 @@ inline void Engine<KeyType, ValueType>::execute_scatter()
 	log("Scatter Wait time: %lf\n", wait_time);
 
 	bitmap_to_array_all();
+	prepare_gather();
 
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::engine_apply(std::pair<KeyType, KeyType*> active_array, VTYPE type, Sender<typename MesgBuf::SyncMesg> *sender[])
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::apply_master(VertexType *v, ValueType total, Sender<SyncMesg> *sender)
 {
+	if(postpone(v, total))
+		return;
+	v_prog->apply(*v, total);
 
-	// int mesg_num_send[mpi_size];
-	// int mesg_num_recv[mpi_size];
-	// memset(mesg_num_send, 0, sizeof(int) * mpi_size);	
-
-	double start = MPI_Wtime();
-
-	// low degree
-
-	KeyType array_size = active_array.first;
-	KeyType *array = active_array.second;
-
-	// sync to mirror
-	// TAG tag = (LOW_MASTER == type) ? SYNC_MIRROR_LOW : SYNC_MIRROR_HIGH;
-	// Sender<typename MesgBuf::SyncMesg> *sender[COMP_THREADS];
-	// for (int i = 0; i < COMP_THREADS; ++i)
-	// 	sender[i] = new Sender<typename MesgBuf::SyncMesg>(comm, tag);
-
+	// master send sync mesg to mirrors
+	if(!v->get_change())
+		return;
 
-	ValueType *local_buf;
-	if(LOW_MASTER == type)
-		local_buf = mesg_buf->get_sync_buf_low();
-	else if(HIGH_MASTER == type)
-		local_buf = mesg_buf->get_sync_buf_high();
-	
+	int thread_id = omp_get_thread_num();
+	num_in_edges[thread_id] += v->in_nbrs_size();
+	num_out_edges[thread_id] += v->out_nbrs_size();
 
-	#pragma omp parallel for num_threads(COMP_THREADS) schedule(OMP_SCHEDULE_TYPE)
-	for (KeyType i = 0; i < array_size; ++i)
+	KeyType gid = v->get_id();
+	auto pair_it = (graph->mirror).find(gid);
+	if((graph->mirror.end()) != pair_it)
 	{
-		int thread_id = omp_get_thread_num();
-
-		KeyType lid = array[i];
-		KeyType gid;
-		VertexType *v;
-		if(LOW_MASTER == type)
-		{
-			gid = graph->ltog_low_master[lid];
-			v = &(((graph->low_degree_master).find(gid))->second);
-		}
-		else //if(HIGH_MASTER == type)
-		{
-			gid = graph->ltog_high_master[lid];
-			v = &(((graph->high_degree_master).find(gid))->second);
-		}
-		// else
-		// 	exit(0);
-
-		v_prog->apply(*v, local_buf[lid]);
-
-		// master send sync mesg to mirrors
-		if(!v->change)
-			continue;
-		
-		num_in_edges[thread_id] += v->in_nbrs_v.size();
-		num_out_edges[thread_id] += v->out_nbrs_v.size();
-
-		auto pair_it = (graph->mirror).find(gid);
-		if((graph->mirror.end()) != pair_it)
+		auto &mirror_set = pair_it->second;
+		for (int mirror_rank : mirror_set)
 		{
-			auto &mirror_set = pair_it->second;
-			for (int mirror_rank : mirror_set)
-			{
-				// if(mirror_rank == rank)
-				// 	continue;
-				typename MesgBuf::SyncMesg *bucket= sender[thread_id]->get_bucket(mirror_rank);
-				bucket->id = gid;
-				bucket->value = v->get_value();
-				// mesg_num_send[mirror_rank]++;
-			}
+			// if(mirror_rank == rank)
+			// 	continue;
+			Sync::put(sender, mirror_rank, gid, (WireType)v->get_value());
+			// mesg_num_send[mirror_rank]++;
 		}
-		// engine_scatter(v);
 	}
-	log("Apply update time: %lf\n", MPI_Wtime() - start);
-
-	// start = MPI_Wtime();
-	// volatile bool is_receiving = true;
-	// #pragma omp parallel num_threads(COMP_THREADS)
-	// {
-	// 	// int thread_id = omp_get_thread_num();
-	// 	// sender[thread_id]->flush();
-	// 	// while(!sender[thread_id]->test_all())
-	// 	// 	irecv();
-	// 	// delete sender[thread_id];
-	// 	if(0 == omp_get_thread_num())
-	// 	{
-	// 		for (int i = 0; i < COMP_THREADS; ++i)
-	// 		{
-	// 			sender[i]->flush();
-	// 			delete sender[i];
-	// 		}
-	// 		MPI_Barrier(comm->mpi_comm);
-	// 		// is_receiving = false;
-	// 	}
-	// 	else
-	// 	{
-	// 		while(comm->is_receiving())
-	// 			irecv();
-	// 	}
-	// }
-
-	// double wait_time = MPI_Wtime() - start;
-	// apply_comm_time += wait_time;
-	// log("Apply wait time: %lf\n", wait_time);
-
 }
 
-
-
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::engine_gather_master(std::pair<KeyType, KeyType*> active_array, VTYPE type)
+/*
+	gather of the masters, within the parallel region of execute_gather
+	their own gather is accumulated with the partials of the mirrors, which may have arrived already
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::engine_gather_master(std::pair<LocalId, LocalId*> active_array, VTYPE type)
 {
-	KeyType array_size = active_array.first;
-	KeyType *array = active_array.second;
+	TRACE_SCOPE(trace_name(0, type));
+	LocalId array_size = active_array.first;
+	LocalId *array = active_array.second;
 
-	double start = MPI_Wtime();
 	ValueType *local_buf;
 	
 	if(LOW_MASTER == type)
@@ -446,174 +731,180 @@ inline void Engine<KeyType, ValueType>::engine_gather_master(std::pair<KeyType,
 	else //if(HIGH_MASTER == type)
 		local_buf = mesg_buf->get_sync_buf_high();
 	
-	#pragma omp parallel for num_threads(COMP_THREADS) schedule(OMP_SCHEDULE_TYPE)
-	for (KeyType i = 0; i < array_size; i++)
+	#pragma omp for schedule(OMP_SCHEDULE_TYPE) nowait
+	for (LocalId i = 0; i < array_size; i++)
 	{
-		KeyType lid = array[i];
-		KeyType gid;
+		LocalId lid = array[i];
 		VertexType *v;
-		ValueType acc = acc_init;
+		ValueType acc;
 		
 		// start = MPI_Wtime();
 		if(LOW_MASTER == type)
-		{
-			gid = graph->ltog_low_master[lid];
-			v = &(((graph->low_degree_master).find(gid))->second);
-		}
+			v = graph->ltov_low_master[lid];
 		else //if(HIGH_MASTER == type)
-		{
-			gid = graph->ltog_high_master[lid];
-			v = &(((graph->high_degree_master).find(gid))->second);
-		}
+			v = graph->ltov_high_master[lid];
 		// else
 		// 	exit(0);
-		v->is_active = false;
+		v->set_active(false);
 
 		// log("search time: %lf\n", MPI_Wtime() - start);
 		// start = MPI_Wtime();
 
-		if(IN_EDGES & v_prog->gather_edge(*v))
-		{
-			// std::vector<KeyType> *nbrs;
-			// nbrs = &(v->get_in_nbr());
-			for(auto nbr_v : v->in_nbrs_v)
-			{
-				// double find_time = MPI_Wtime();
-				// auto &nbr_v = graph->find_vertex(nbr_id);
-				// log("Note: find_time: %.10lf\n", MPI_Wtime() - find_time);
-				acc = v_prog->op(v_prog->gather(*v, *nbr_v), acc);
-			}
-		}
-		if(OUT_EDGES & v_prog->gather_edge(*v))
-		{
-			// std::vector<KeyType> *nbrs;
-			// nbrs = &(v->get_out_nbr());
-			for(auto nbr_v : v->out_nbrs_v)
-			{
-				// auto &nbr_v = graph->find_vertex(nbr_id);
-				acc = v_prog->op(v_prog->gather(*v, *nbr_v), acc);
-			}
-		}
+		acc = gather_vertex(v);
 		// if(!v_prog->gather_edge())
 		// 	acc = v_prog->op(v_prog->gather(*v, *v), acc); // the second *v should never be used
 
-		
-		local_buf[lid] = acc;
+		// no other rank has a part of its gather, so it is applied in the same pass and skipped by the apply phase
+		if(fused && !v->replicated)
+		{
+			if(postpone(v, acc))
+				continue;
+			v_prog->apply(*v, acc);
+			if(!v->get_change())
+				continue;
+			int thread_id = omp_get_thread_num();
+			num_in_edges[thread_id] += v->in_nbrs_size();
+			num_out_edges[thread_id] += v->out_nbrs_size();
+			continue;
+		}
+		mesg_buf->accumulate(local_buf + lid, acc);
+		contribute(HIGH_MASTER == type, lid);
 	}
-	log("MASTER gather Time: %lf\n", MPI_Wtime() - start);
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::engine_gather_mirror(std::pair<KeyType, KeyType*> active_array, VTYPE type)
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::engine_gather_mirror(std::pair<LocalId, LocalId*> active_array, VTYPE type, Sender<SyncMesg> *sender[])
 {
 	if((IN_EDGES == v_prog->gather_edge()) && (type == LOW_MIRROR))
 		return;
+	TRACE_SCOPE(trace_name(0, type));
 
-	KeyType array_size = active_array.first;
-	KeyType *array = active_array.second;
+	LocalId array_size = active_array.first;
+	LocalId *array = active_array.second;
 
-	TAG tag = (LOW_MIRROR == type) ? SYNC_MASTER_LOW : SYNC_MASTER_HIGH;
-	Sender<typename MesgBuf::SyncMesg> *sender[COMP_THREADS];
-	for (int i = 0; i < COMP_THREADS; ++i)
-		sender[i] = new Sender<typename MesgBuf::SyncMesg>(comm, tag);
-	
 	double start = MPI_Wtime();
 	#pragma omp parallel for num_threads(COMP_THREADS) schedule(OMP_SCHEDULE_TYPE)
-	for (KeyType i = 0; i < array_size; i++)
+	for (LocalId i = 0; i < array_size; i++)
 	{
 		int thread_id = omp_get_thread_num();
 
-		KeyType lid = array[i];
+		LocalId lid = array[i];
 		KeyType gid;
 		VertexType *v;
-		ValueType acc = acc_init;
+		ValueType acc;
 		// start = MPI_Wtime();
 
 		if(LOW_MIRROR == type)
 		{
 			// if(graph->ltog_low_mirror.find(lid) == graph->ltog_low_mirror.end())
 			// 	log("rank: %d, Error: low mirror lid %d not found\n", rank, lid);
-			gid = graph->ltog_low_mirror[lid];
-			v = &(((graph->low_degree_mirror).find(gid))->second);
+			v = graph->ltov_low_mirror[lid];
+			gid = v->get_id();
 		}
 		else //if(HIGH_MIRROR == type)
 		{
 			// if(graph->ltog_high_mirror.find(lid) == graph->ltog_high_mirror.end())
 			// 	log("rank: %d, Error: high mirror lid %d not found\n", rank, lid);
-			gid = graph->ltog_high_mirror[lid];
-			v = &(((graph->high_degree_mirror).find(gid))->second);
+			v = graph->ltov_high_mirror[lid];
+			gid = v->get_id();
 		}
 		// else
 		// 	exit(0);
-		v->is_active = false;
+		v->set_active(false);
 
 		// log("search time: %lf\n", MPI_Wtime() - start);
 		// start = MPI_Wtime();
-		if((IN_EDGES & v_prog->gather_edge(*v)))
-		{
-			// std::vector<KeyType> *nbrs;
-			// nbrs = &(v->get_in_nbr());
-			for(auto nbr_v : v->in_nbrs_v)
-			{
-				// auto &nbr_v = graph->find_vertex(nbr_id);
-				acc = v_prog->op(v_prog->gather(*v, *nbr_v), acc);
-			}
-		}
-		if(OUT_EDGES & v_prog->gather_edge(*v))
-		{
-			// std::vector<KeyType> *nbrs;
-			// nbrs = &(v->get_out_nbr());
-			for(auto nbr_v : v->out_nbrs_v)
-			{
-				// auto &nbr_v = graph->find_vertex(nbr_id);
-				acc = v_prog->op(v_prog->gather(*v, *nbr_v), acc);
-			}
-		}
+		acc = gather_vertex(v);
 		// if(!v_prog->gather_edge())
 		// 	acc = v_prog->op(v_prog->gather(*v, *v), acc); // the second *v should never be used
 		// log("nbrs gathering time: %lf\n", MPI_Wtime() - start);
 		// start = MPI_Wtime();
 		int target_rank = graph->hash(gid);
-		typename MesgBuf::SyncMesg *bucket = sender[thread_id]->get_bucket(target_rank);
-		bucket->id = gid;
-		bucket->value = acc;
+		Sync::put(sender[thread_id], target_rank, gid, (WireType)acc);
 	
 	}
+	gather_comp_time += MPI_Wtime() - start;
 	log("MIRROR gather compute Time: %lf\n", MPI_Wtime() - start);
+}
 
-	start = MPI_Wtime();
-	// volatile bool is_receiving = true;
-	#pragma omp parallel num_threads(COMP_THREADS)
+template<class KeyType, class ValueType, class WireType>
+inline ValueType Engine<KeyType, ValueType, WireType>::gather_vertex(VertexType *v)
+{
+	if(!cache)
+		return gather_nbrs(v);
+	// the cached value is kept up to date by post_delta() once gathered
+	if(!cached[v->index])
 	{
-		if(0 == omp_get_thread_num())
-		{
-			for (int i = 0; i < COMP_THREADS; ++i)
-			{
-				sender[i]->flush();
-				delete sender[i];
-			}
-			MPI_Barrier(comm->mpi_comm);
-			// is_receiving = false;
-		}
-		else
-		{
-			while(comm->is_receiving())
-				irecv();
-		}
+		cache[v->index] = gather_nbrs(v);
+		cached[v->index] = true;
+	}
+	return cache[v->index];
+}
+
+template<class KeyType, class ValueType, class WireType>
+inline ValueType Engine<KeyType, ValueType, WireType>::gather_nbrs(VertexType *v)
+{
+	ValueType acc = acc_init;
+	if(contrib)
+	{
+		if(IN_EDGES & v_prog->gather_edge(*v))
+			acc = v_prog->op(graph->sum_in_nbr(*v, contrib), acc);
+		if(OUT_EDGES & v_prog->gather_edge(*v))
+			acc = v_prog->op(graph->sum_out_nbr(*v, contrib), acc);
+		return acc;
 	}
-	double wait_time = MPI_Wtime() - start;
-	gather_comm_time += wait_time;
-	log("MIRROR gather wait time: %lf\n", wait_time);
 
+	auto gather_nbr = [&](VertexType *nbr_v, WeightType weight)
+	{
+		acc = v_prog->op(v_prog->gather(*v, *nbr_v, weight), acc);
+	};
+	if(IN_EDGES & v_prog->gather_edge(*v))
+		graph->for_each_in_nbr(*v, gather_nbr);
+	if(OUT_EDGES & v_prog->gather_edge(*v))
+		graph->for_each_out_nbr(*v, gather_nbr);
+	return acc;
 }
 
+/*
+	add the change of v into the cached values of its local nbrs that gather it
+	every changed replica posts on its own rank, where it shares its edges with the replicas of the nbrs
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::post_delta(VertexType *v)
+{
+	if(!v->get_change())
+		return;
+	if(IN_EDGES & v_prog->gather_edge())
+		graph->for_each_out_nbr(*v, [&](VertexType *nbr_v, WeightType weight)
+		{
+			if(cached[nbr_v->index] && (IN_EDGES & v_prog->gather_edge(*nbr_v)))
+				mesg_buf->accumulate(cache + nbr_v->index, v_prog->gather_delta(*nbr_v, *v, weight));
+		});
+	if(OUT_EDGES & v_prog->gather_edge())
+		graph->for_each_in_nbr(*v, [&](VertexType *nbr_v, WeightType weight)
+		{
+			if(cached[nbr_v->index] && (OUT_EDGES & v_prog->gather_edge(*nbr_v)))
+				mesg_buf->accumulate(cache + nbr_v->index, v_prog->gather_delta(*nbr_v, *v, weight));
+		});
+}
 
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::compute_contrib()
+{
+	double start = MPI_Wtime();
+	size_t num = graph->local_vertex.size();
+	#pragma omp parallel for num_threads(COMP_THREADS)
+	for (size_t i = 0; i < num; ++i)
+		contrib[i] = v_prog->contribution(*(graph->local_vertex[i]));
+	gather_comp_time += MPI_Wtime() - start;
+}
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::engine_scatter(std::pair<KeyType, KeyType*> active_array, VTYPE type, Sender<typename MesgBuf::ActMesg> *sender[])
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::engine_scatter(std::pair<LocalId, LocalId*> active_array, VTYPE type, Sender<typename MesgBuf::ActMesg> *sender[])
 {
-	KeyType array_size = active_array.first;
-	KeyType *array = active_array.second;
+	TRACE_SCOPE(trace_name(2, type));
+	LocalId array_size = active_array.first;
+	LocalId *array = active_array.second;
 
 	// int num_in_nbrs[COMP_THREADS];
 	// int num_out_nbrs[COMP_THREADS];
@@ -624,37 +915,32 @@ inline void Engine<KeyType, ValueType>::engine_scatter(std::pair<KeyType, KeyTyp
 	// }
 
 	#pragma	omp parallel for num_threads(COMP_THREADS)
-	for (KeyType i = 0; i < array_size; ++i)
+	for (LocalId i = 0; i < array_size; ++i)
 	{
 		int thread_id = omp_get_thread_num();
 
-		KeyType lid = array[i];
-		KeyType gid;
+		LocalId lid = array[i];
 		VertexType *v;
 		switch(type)
 		{
 			case LOW_MASTER: 
 			{
-				gid = graph->ltog_low_master[lid];
-				v = &(((graph->low_degree_master).find(gid))->second);
+				v = graph->ltov_low_master[lid];
 				break;
 			}
 			case LOW_MIRROR:
 			{
-				gid = graph->ltog_low_mirror[lid];
-				v = &(((graph->low_degree_mirror).find(gid))->second);
+				v = graph->ltov_low_mirror[lid];
 				break;
 			}
 			case HIGH_MASTER:
 			{
-				gid = graph->ltog_high_master[lid];
-				v = &(((graph->high_degree_master).find(gid))->second);
+				v = graph->ltov_high_master[lid];
 				break;
 			}
 			case HIGH_MIRROR:
 			{
-				gid = graph->ltog_high_mirror[lid];
-				v = &(((graph->high_degree_mirror).find(gid))->second);
+				v = graph->ltov_high_mirror[lid];
 				break;
 			}
 			default: log("Wrong type\n"); exit(0);
@@ -662,111 +948,214 @@ inline void Engine<KeyType, ValueType>::engine_scatter(std::pair<KeyType, KeyTyp
 		// num_in_nbrs[thread_id] += v->get_in_nbr().size();
 		// num_out_nbrs[thread_id] += v->get_out_nbr().size();
 
-		if(IN_EDGES & v_prog->scatter_edge(*v))
+		if(cache)
+			post_delta(v);
+		scatter_vertex(v, v_prog->scatter_edge(*v), false, sender[thread_id]);
+		// a mirror only gets a new change with a new value
+		if(cache)
+			v->set_change(ValueType());
+	}
+
+	// int in = 0, out = 0;
+	// for (int i = 0; i < COMP_THREADS; ++i)
+	// {
+	// 	in += num_in_nbrs[i];
+	// 	out += num_out_nbrs[i];
+	// }
+	// log("Note: in: %d, out:%d\n", in, out);
+}
+
+/*
+	activate the nbrs of v that scatter() asks for, over the given edges
+	under priority scheduling, the edges heavier than the bucket width are left for the heavy pass, which scatters
+	them only, once the bucket is done
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::scatter_vertex(VertexType *v, EDGE_DIRECTION edges, bool heavy_pass, Sender<typename MesgBuf::ActMesg> *sender)
+{
+	bool skipped = false;
+	auto scatter_nbr = [&](VertexType *nbr_v, WeightType weight)
+	{
+		if(width > 0 && (weight > width) != heavy_pass)
+		{
+			skipped = true;
+			return;
+		}
+		KeyType nbr_id = nbr_v->get_id();
+		if(!v_prog->scatter(*v, *nbr_v, weight))
+			return;
+		int nbr_rank = graph->hash(nbr_id);
+		if(rank == nbr_rank)
 		{
-			// std::vector<KeyType> *nbrs;
-			// nbrs = &(v->get_in_nbr());
-			for (auto nbr_v : v->in_nbrs_v)
+			if(nbr_v->is_active() || graph->insert_active_master(nbr_id))
+				return;
+			nbr_v->set_active(true);
+			auto pair_it = (graph->mirror).find(nbr_id);
+			if((graph->mirror).end() != pair_it)
 			{
-				// auto &nbr_v = graph->find_vertex(nbr);
-				KeyType nbr_id = nbr_v->get_id();
-				if(v_prog->scatter(*v, *nbr_v))
+				auto &mirror_set = pair_it->second;
+				for (int mirror_rank : mirror_set)
 				{
-					// auto &nbr_v = graph->find_vertex(nbr);
-					int nbr_rank = graph->hash(nbr_id);
-					if(rank == nbr_rank)
-					{
-						if(nbr_v->is_active || graph->insert_active_master(nbr_id))
-							continue;
-						nbr_v->is_active = true;
-						auto pair_it = (graph->mirror).find(nbr_id);
-						if((graph->mirror).end() != pair_it)
-						{
-							auto &mirror_set = pair_it->second;
-							for (int mirror_rank : mirror_set)
-							{
-								typename MesgBuf::ActMesg *bucket = sender[thread_id]->get_bucket(mirror_rank);
-								bucket->id = nbr_id;
-							}
-						}
-					}
-					else
-					{
-						if(nbr_v->is_active || graph->insert_active_mirror(nbr_id))
-							continue;
-						nbr_v->is_active = true;
-						for (int target_rank = 0; target_rank < mpi_size; ++target_rank)
-						{
-							if(target_rank == rank)
-								continue;
-							typename MesgBuf::ActMesg *bucket = sender[thread_id]->get_bucket(target_rank);
-							bucket->id = nbr_id;
-						}
-					}
+					typename MesgBuf::ActMesg *bucket = sender->get_bucket(mirror_rank);
+					bucket->id = nbr_id;
 				}
 			}
 		}
-		if(OUT_EDGES & v_prog->scatter_edge(*v))
+		else
 		{
-			// std::vector<KeyType> *nbrs;
-			// nbrs = &(v->get_out_nbr());
-			for (auto nbr_v : v->out_nbrs_v)
+			if(nbr_v->is_active() || graph->insert_active_mirror(nbr_id))
+				return;
+			nbr_v->set_active(true);
+			for (int target_rank = 0; target_rank < mpi_size; ++target_rank)
 			{
-				// auto &nbr_v = graph->find_vertex(nbr);
-				KeyType nbr_id = nbr_v->get_id();
-				if(v_prog->scatter(*v, *nbr_v))
+				if(target_rank == rank)
+					continue;
+				typename MesgBuf::ActMesg *bucket = sender->get_bucket(target_rank);
+				bucket->id = nbr_id;
+			}
+		}
+	};
+	if(IN_EDGES & edges)
+		graph->for_each_in_nbr(*v, scatter_nbr);
+	if(OUT_EDGES & edges)
+		graph->for_each_out_nbr(*v, scatter_nbr);
+	if(skipped && !heavy_pass && !heavy[v->index])
+	{
+		heavy[v->index] = 1;
+		heavy_replicas[omp_get_thread_num()].push_back(v);
+	}
+}
+
+/*
+	under priority scheduling, a master whose priority with total falls in a later bucket than the current one keeps
+	its value until that bucket, see next_bucket
+*/
+template<class KeyType, class ValueType, class WireType>
+inline bool Engine<KeyType, ValueType, WireType>::postpone(VertexType *v, ValueType total)
+{
+	if(width <= 0)
+		return false;
+	long b = (long)(v_prog->priority(*v, total) / width);
+	if(b <= bucket)
+	{
+		postponed_bucket[v->index] = NO_BUCKET;
+		return false;
+	}
+	int thread_id = omp_get_thread_num();
+	if(!listed[v->index])
+	{
+		listed[v->index] = 1;
+		postponed[thread_id].push_back(v);
+	}
+	postponed_bucket[v->index] = b;
+	// nothing to scatter until it is applied
+	v->set_change(ValueType());
+	num_postponed[thread_id]++;
+	return true;
+}
+
+/*
+	called when no master is active any more in the current bucket:
+	the replicas changed in the bucket scatter their heavy edges, and if that activates nothing, the masters postponed
+	to the lowest bucket left are activated with their mirrors, which starts that bucket
+	returns the number of active masters of all ranks, none when no bucket is left
+*/
+template<class KeyType, class ValueType, class WireType>
+inline unsigned long Engine<KeyType, ValueType, WireType>::next_bucket()
+{
+	unsigned long global_active = 0;
+	while(!global_active)
+	{
+		std::vector<VertexType *> replicas;
+		for (int i = 0; i < COMP_THREADS; ++i)
+		{
+			replicas.insert(replicas.end(), heavy_replicas[i].begin(), heavy_replicas[i].end());
+			heavy_replicas[i].clear();
+		}
+		unsigned long local_heavy = replicas.size(), global_heavy;
+		MPI_Allreduce(&local_heavy, &global_heavy, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm->mpi_comm);
+
+		Sender<typename MesgBuf::ActMesg> *sender[COMP_THREADS];
+		for (int i = 0; i < COMP_THREADS; ++i)
+			sender[i] = new Sender<typename MesgBuf::ActMesg>(comm, ACT);
+		if(global_heavy)
+		{
+			#pragma omp parallel for num_threads(COMP_THREADS)
+			for (size_t i = 0; i < replicas.size(); ++i)
+			{
+				heavy[replicas[i]->index] = 0;
+				scatter_vertex(replicas[i], v_prog->scatter_edge(), true, sender[omp_get_thread_num()]);
+			}
+		}
+		else
+		{
+			std::vector<VertexType *> masters;
+			long local_min = NO_BUCKET;
+			for (int i = 0; i < COMP_THREADS; ++i)
+			{
+				for(auto v : postponed[i])
 				{
-					// double hash_time = MPI_Wtime();
-					int nbr_rank = graph->hash(nbr_id);
-					// log("Note: hash_time: %.10lf\n", MPI_Wtime() - hash_time);
-					if(rank == nbr_rank)
+					// applied since
+					if(NO_BUCKET == postponed_bucket[v->index])
 					{
-						if(nbr_v->is_active || graph->insert_active_master(nbr_id))
-							continue;
-						nbr_v->is_active = true;
-						auto pair_it = (graph->mirror).find(nbr_id);
-						if((graph->mirror).end() != pair_it)
-						{
-							auto &mirror_set = pair_it->second;
-							for (int mirror_rank : mirror_set)
-							{
-								typename MesgBuf::ActMesg *bucket = sender[thread_id]->get_bucket(mirror_rank);
-								bucket->id = nbr_id;
-								// log("Note:rank: %d, mirror_rank: %d, master act id:%d nbr:%d\n", rank, mirror_rank, v->get_id(), bucket->id);
-							}
-						}
-					}
-					else
-					{
-						if(nbr_v->is_active || graph->insert_active_mirror(nbr_id))
-							continue;
-						nbr_v->is_active = true;
-						for (int target_rank = 0; target_rank < mpi_size; ++target_rank)
-						{
-							if(target_rank == rank)
-								continue;
-							typename MesgBuf::ActMesg *bucket = sender[thread_id]->get_bucket(target_rank);
-							bucket->id = nbr_id;
-							// log("Note:rank: %d, mirror_rank: %d, mirror act id:%d nbr:%d\n", rank, target_rank, v->get_id(), nbr);
-						}
+						listed[v->index] = 0;
+						continue;
 					}
+					masters.push_back(v);
+					local_min = std::min(local_min, postponed_bucket[v->index]);
+				}
+				postponed[i].clear();
+			}
+			MPI_Allreduce(&local_min, &bucket, 1, MPI_LONG, MPI_MIN, comm->mpi_comm);
+			if(NO_BUCKET == bucket)
+			{
+				for (int i = 0; i < COMP_THREADS; ++i)
+					delete sender[i];
+				return 0;
+			}
+			num_buckets++;
+			log("Rank: %d, bucket: %ld\n", rank, bucket);
+			for(auto v : masters)
+			{
+				if(postponed_bucket[v->index] > bucket)
+				{
+					postponed[0].push_back(v);
+					continue;
 				}
+				listed[v->index] = 0;
+				postponed_bucket[v->index] = NO_BUCKET;
+				KeyType id = v->get_id();
+				if(v->is_active() || graph->insert_active_master(id))
+					continue;
+				v->set_active(true);
+				auto pair_it = (graph->mirror).find(id);
+				if((graph->mirror).end() == pair_it)
+					continue;
+				for (int mirror_rank : pair_it->second)
+					sender[0]->get_bucket(mirror_rank)->id = id;
 			}
 		}
-	}
+		for (int i = 0; i < COMP_THREADS; ++i)
+		{
+			sender[i]->flush();
+			delete sender[i];
+		}
+		MPI_Barrier(comm->mpi_comm);
+		while(comm->is_receiving());
 
-	// int in = 0, out = 0;
-	// for (int i = 0; i < COMP_THREADS; ++i)
-	// {
-	// 	in += num_in_nbrs[i];
-	// 	out += num_out_nbrs[i];
-	// }
-	// log("Note: in: %d, out:%d\n", in, out);
+		bitmap_to_array_all();
+		prepare_gather();
+		// no rank gathers before every rank has prepared
+		unsigned long local_active = (graph->low_active_master).size() + (graph->high_active_master).size();
+		MPI_Allreduce(&local_active, &global_active, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm->mpi_comm);
+	}
+	return global_active;
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::bitmap_to_array_all()
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::bitmap_to_array_all()
 {
+	TRACE_SCOPE("active arrays");
 	double transfer = MPI_Wtime();
 	#pragma omp parallel sections num_threads(4)
 	{
@@ -790,30 +1179,33 @@ inline void Engine<KeyType, ValueType>::bitmap_to_array_all()
 	log("transfer time: %lf\n", MPI_Wtime() - transfer);
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::bitmap_to_array(BitMap &active_set, std::pair<KeyType, KeyType*> &active_array)
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::bitmap_to_array(BitMap &active_set, std::pair<LocalId, LocalId*> &active_array)
 {
 	size_t index = 0;
 
 	size_t id;
-	while(active_set.next_bit(&id))
+	// activations arrive at any time in the stale synchronous mode, so they are taken out of the bitmap atomically
+	while(next_active(active_set, &id))
 	{
-		// active_array[index] = ltog[(KeyType)id];
-		active_array.second[index] = (KeyType)id;
+		active_array.second[index] = (LocalId)id;
 		index++;
 	}
 	active_set.set_size(index);
-	active_array.first = (KeyType)index;
+	active_array.first = (LocalId)index;
 
 }
 
-template<class KeyType, class ValueType>
-inline void Engine<KeyType, ValueType>::irecv()
+template<class KeyType, class ValueType, class WireType>
+inline void Engine<KeyType, ValueType, WireType>::irecv()
 {
 	int tag;
 	void *recv_buf = NULL;
 	if(comm->irecv(&tag, &recv_buf))
+	{
+		TRACE_SCOPE("process messages");
 		mesg_buf->process_mesg(tag, recv_buf);
+	}
 }
 
 #endif
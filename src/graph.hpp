@@ -12,11 +12,22 @@
 #include "bitmap.hpp"
 #include "log.h"
 #include "sender.hpp"
+#include "simd.hpp"
+#include "output.hpp"
 #include <unordered_map>
+#include <unordered_set>
 #include <set>
+#include <algorithm>
+#include <limits>
+#include <climits>
+#include <tuple>
+#include <string>
 
 #include <assert.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <glob.h>
 #include <sys/stat.h>
 inline long file_size(const char *filename) {
   struct stat st;
@@ -24,13 +35,161 @@ inline long file_size(const char *filename) {
   return st.st_size;
 }
 
-template<typename KeyType, typename ValueType>
+/*
+	input files of a graph: a single file, every file of a directory or the matches of a glob pattern
+	sorted by name so that all ranks see the same order
+*/
+inline bool list_shards(const char *path, std::vector<std::string> &shards)
+{
+	struct stat st;
+	if(0 == stat(path, &st) && S_ISDIR(st.st_mode))
+	{
+		DIR *dir = opendir(path);
+		if(!dir)
+			return false;
+		while(struct dirent *entry = readdir(dir))
+		{
+			if('.' == entry->d_name[0])
+				continue;
+			std::string file = std::string(path) + "/" + entry->d_name;
+			if(0 == stat(file.c_str(), &st) && S_ISREG(st.st_mode))
+				shards.push_back(file);
+		}
+		closedir(dir);
+	}
+	else
+	{
+		glob_t result;
+		if(0 == glob(path, 0, NULL, &result))
+			for (size_t i = 0; i < result.gl_pathc; ++i)
+				shards.push_back(result.gl_pathv[i]);
+		globfree(&result);
+	}
+	std::sort(shards.begin(), shards.end());
+	return !shards.empty();
+}
+
+// bytes per read call when loading the shards
+const size_t READ_CHUNK = 1 << 26;
+
+/*
+	on-disk edges, IdType is the id width of the file (32 or 64 bits),
+	independent of the KeyType of the graph
+*/
+template<typename IdType>
 struct EdgeUnit
 {
-	KeyType src;
-	KeyType dst;
+	IdType src;
+	IdType dst;
+};
+
+template<typename IdType>
+struct __attribute__((packed)) WeightedEdgeUnit
+{
+	IdType src;
+	IdType dst;
+	WeightType weight;
+};
+
+template<typename IdType>
+inline WeightType edge_weight(EdgeUnit<IdType> &edge) {return 1;}
+template<typename IdType>
+inline WeightType edge_weight(WeightedEdgeUnit<IdType> &edge) {return edge.weight;}
+template<typename IdType>
+inline void set_edge_weight(EdgeUnit<IdType> &edge, WeightType weight) {}
+template<typename IdType>
+inline void set_edge_weight(WeightedEdgeUnit<IdType> &edge, WeightType weight) {edge.weight = weight;}
+
+/*
+	an edge inserted into or deleted from a loaded graph, see Graph::update_edges
+*/
+template<typename IdType>
+struct EdgeUpdate
+{
+	IdType src;
+	IdType dst;
+	WeightType weight;
+	bool insert;
+};
+
+// "+ src dst [weight]" inserts an edge, "- src dst" deletes one, false for any other line
+template<typename IdType>
+inline bool parse_update(const char *line, EdgeUpdate<IdType> &update)
+{
+	char op;
+	unsigned long long src, dst;
+	float weight = 1;
+	if(sscanf(line, " %c %llu %llu %f", &op, &src, &dst, &weight) < 3 || ('+' != op && '-' != op))
+		return false;
+	update = EdgeUpdate<IdType>{(IdType)src, (IdType)dst, weight, '+' == op};
+	return true;
+}
+
+// the updates of a file, a line each as parse_update reads them
+template<typename IdType>
+inline bool read_updates(const char *path, std::vector<EdgeUpdate<IdType> > &batch)
+{
+	FILE *fp = fopen(path, "r");
+	if(!fp)
+		return false;
+	char line[256];
+	EdgeUpdate<IdType> update;
+	while(fgets(line, sizeof(line), fp))
+		if(parse_update(line, update))
+			batch.push_back(update);
+	fclose(fp);
+	return true;
+}
+
+/*
+	messages between the ranks while a batch of updates is applied
+*/
+typedef enum
+{
+	UPDATE_INSERT = 0, // an update at the rank of its dst
+	UPDATE_DELETE = 1,
+	HIGH_INSERT = 2, // an update of an edge of a high degree dst, at the rank of its src
+	HIGH_DELETE = 3,
+	HIGH_MOVE = 4, // an in edge of a vertex promoted to high degree, moved to the rank of its src
+	PROMOTE = 5, // src became high degree, it has a high degree mirror on every rank
+	MIRROR_ADD = 6, // the mirror of src at rank dst has its first edge
+	MIRROR_REMOVE = 7, // the mirror of src at rank dst has no edges left
+	ACTIVATE = 8 // src is an endpoint of an update, sent to its master
+} UPDATE_STEP;
+
+template<typename IdType>
+struct UpdateMesg
+{
+	IdType src;
+	IdType dst;
+	WeightType weight;
+	uint8_t step;
 };
 
+/*
+	hash of an edge of a vertex, the fingerprint of its adjacency is the sum over its edges,
+	independent of their order and of the ranks they are placed on
+*/
+inline uint64_t edge_hash(uint64_t nbr, WeightType weight, bool out)
+{
+	uint32_t bits;
+	memcpy(&bits, &weight, sizeof(bits));
+	uint64_t x = ((nbr << 1) | out) ^ (bits * 0x9E3779B97F4A7C15ULL);
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+/*
+	local id order of the vertices on each rank
+*/
+typedef enum
+{
+	REORDER_NONE = 0, // unordered_map iteration order
+	REORDER_HUB = 1, // hub clustering: vertices above average degree first, sorted by degree
+	REORDER_RCM = 2 // reverse Cuthill-McKee over all local vertices
+} REORDER_TYPE;
+
 template<class KeyType, class ValueType>
 class Graph
 {
@@ -45,16 +204,52 @@ private:
 	MesgBuf *mesg_buf;
 	size_t threshold;
 	ValueType default_value;
+	int reorder_type;
+	bool compressed;
+	bool weighted;
+	int id_bits;
 
 	int size;
 	int rank;
 	
 
-	inline void insert_vertex(VertexContainer &vertex_container, KeyType id, ValueType value, KeyType nbr, bool is_in);
+	inline void insert_vertex(VertexContainer &vertex_container, KeyType id, KeyType nbr, WeightType weight, bool is_in);
 	inline void insert_mirror(KeyType &id, int rank);
+	inline void reserve_nbr(VertexType &v, size_t num, bool is_in);
 
-	void init_map();
+	void compute_order(std::vector<KeyType> order[]);
+	void relocate(VertexContainer &vertex_container, std::vector<KeyType> &order);
+	void init_map(std::vector<KeyType> order[]);
+	void init_map(VertexContainer &vertex_container, std::vector<KeyType> &order, BitMap &active,
+		std::unordered_map<KeyType, LocalId> &gtol, std::unordered_map<LocalId, KeyType> &ltog, std::vector<VertexType *> &ltov);
 	void init_nbr_ptr(VertexType &v);
+	template<class NbrType>
+	inline void sort_nbrs(std::vector<NbrType> &nbrs, WeightType *weights);
+	template<class Func>
+	inline void for_each_nbr(std::vector<LocalId> &nbrs_i, CompressedList &nbrs_c, const WeightType *weight, Func f);
+	inline ValueType sum_nbr(std::vector<LocalId> &nbrs_i, CompressedList &nbrs_c, const ValueType *array);
+	template<class UnitType>
+	void load_edges(char const *file_path);
+	template<class UnitType>
+	void read_shards(std::vector<std::string> &shards, std::vector<UnitType> &buffer);
+	template<class UnitType>
+	void shuffle_edges(std::vector<UnitType> &buffer);
+	template<class T>
+	void exchange(std::vector<std::vector<T> > &out, std::vector<T> &in);
+	void adjacency_fingerprints(std::vector<uint64_t> &fingerprint);
+	void warm_start(const char *path);
+
+	// ids of the local indexes before update_edges, by which the nbr lists of the changed vertices are read
+	std::vector<KeyType> old_ids;
+	inline VertexType *find_copy(KeyType id);
+	inline VertexType &add_copy(VertexContainer &vertex_container, KeyType id);
+	inline VertexType &move_copy(VertexContainer &from, VertexContainer &to, KeyType id);
+	void expand_nbrs(VertexType &v);
+	inline void add_nbr(VertexType &v, KeyType nbr, WeightType weight, bool is_in);
+	inline bool remove_nbr(VertexType &v, KeyType nbr, bool is_in);
+	inline size_t num_nbrs(VertexType &v);
+	void remap_nbrs(VertexType &v, std::vector<LocalId> &remap);
+	void rebuild();
 
 public:
 	// vertex unordered map
@@ -64,7 +259,7 @@ public:
 	VertexContainer low_degree_mirror;
 	VertexContainer high_degree_mirror;
 
-	unsigned long num_edges;
+	unsigned long num_edges; // of the whole graph
 
 	/*
 		mirror: id -> mirror rank set
@@ -84,17 +279,42 @@ public:
 		global to local
 		local to global
 	*/
-	std::unordered_map<KeyType, KeyType> gtol_low_master;
-	std::unordered_map<KeyType, KeyType> gtol_low_mirror;
-	std::unordered_map<KeyType, KeyType> gtol_high_master;
-	std::unordered_map<KeyType, KeyType> gtol_high_mirror;
+	std::unordered_map<KeyType, LocalId> gtol_low_master;
+	std::unordered_map<KeyType, LocalId> gtol_low_mirror;
+	std::unordered_map<KeyType, LocalId> gtol_high_master;
+	std::unordered_map<KeyType, LocalId> gtol_high_mirror;
+
+	std::unordered_map<LocalId, KeyType> ltog_low_master;
+	std::unordered_map<LocalId, KeyType> ltog_low_mirror;
+	std::unordered_map<LocalId, KeyType> ltog_high_master;
+	std::unordered_map<LocalId, KeyType> ltog_high_mirror;
+
+	/*
+		local id to vertex
+	*/
+	std::vector<VertexType *> ltov_low_master;
+	std::vector<VertexType *> ltov_low_mirror;
+	std::vector<VertexType *> ltov_high_master;
+	std::vector<VertexType *> ltov_high_mirror;
+
+	/*
+		local index to vertex, over all local vertices
+		low master, low mirror, high master and high mirror in turn
+	*/
+	std::vector<VertexType *> local_vertex;
+	// value, change and active flag of every local vertex in the same order, reached through the vertices
+	VertexState<ValueType> vertex_state;
+	// masters without mirrors, which are not replicated on any other rank
+	unsigned long num_local_only;
 
-	std::unordered_map<KeyType, KeyType> ltog_low_master;
-	std::unordered_map<KeyType, KeyType> ltog_low_mirror;
-	std::unordered_map<KeyType, KeyType> ltog_high_master;
-	std::unordered_map<KeyType, KeyType> ltog_high_mirror;
+	/*
+		edge values of weighted graphs, beside the adjacency
+		in weights followed by out weights of each vertex, starting at its edge_offset
+	*/
+	std::vector<WeightType> edge_weights;
 
-	Graph(ControllerType *controller, char const *file_path, size_t threshold, ValueType default_value):controller(controller), threshold(threshold), default_value(default_value)
+	Graph(ControllerType *controller, char const *file_path, size_t threshold, ValueType default_value, int reorder_type = REORDER_NONE, bool compressed = false, bool weighted = false, int id_bits = 32):
+		controller(controller), threshold(threshold), default_value(default_value), reorder_type(reorder_type), compressed(compressed), weighted(weighted), id_bits(id_bits)
 	{
 		comm = controller->comm;
 		size = comm->get_size();
@@ -108,122 +328,192 @@ public:
 
 	inline int hash(KeyType id) {return id % size;}
 	inline VertexType &find_vertex(KeyType id);
+	// position of a local vertex in local_vertex
+	inline LocalId local_index(KeyType id);
+	inline bool find_local(KeyType id, LocalId &index);
 	inline bool insert_active_master(KeyType id);
 	inline bool insert_active_mirror(KeyType id);
+	// the active bit of a local vertex by its index in local_vertex
+	inline void set_active(size_t index);
+	inline bool get_active(size_t index);
 
-	void transform_vertices(bool (*init_fun)(VertexType &v));
+	/*
+		initialize the values and active bits, with prior, from the binary results of an earlier run
+		written with OUTPUT_ADJACENCY, see warm_start()
+	*/
+	void transform_vertices(bool (*init_fun)(VertexType &v), const char *prior = NULL);
+	// initialize the values and active bits again for another run, the adjacency is kept
+	void reset_vertices(bool (*init_fun)(VertexType &v));
+	// write the values of the masters of every rank, see OUTPUT_TYPE, collective
+	void write_values(const char *path, int output_type);
+	// insert and delete the edges of the batches of all ranks and activate their endpoints, collective, returns the number deleted
+	unsigned long update_edges(std::vector<EdgeUpdate<KeyType> > &batch, bool (*init_fun)(VertexType &v));
+	// send the updates of all ranks to the ranks of their dst through the edge messages, collective
+	void route_updates(std::vector<EdgeUpdate<KeyType> > &batch);
+	// mean weight of the edges of all ranks, 1 for an unweighted graph, collective
+	double mean_edge_weight();
+
+	template<class Func>
+	inline void for_each_in_nbr(VertexType &v, Func f);
+	template<class Func>
+	inline void for_each_out_nbr(VertexType &v, Func f);
+	inline ValueType sum_in_nbr(VertexType &v, const ValueType *array);
+	inline ValueType sum_out_nbr(VertexType &v, const ValueType *array);
 
 };
 
 template<class KeyType, class ValueType>
 void Graph<KeyType, ValueType>::load(char const *file_path)
 {
-	
-	
-	std::ifstream fin(file_path);
-	if(!fin.is_open())
+	if(64 == id_bits)
+	{
+		if(weighted)
+			load_edges<WeightedEdgeUnit<uint64_t> >(file_path);
+		else
+			load_edges<EdgeUnit<uint64_t> >(file_path);
+	}
+	else
 	{
-		log("Error: Failed to open file\n");
-		exit(0);
+		if(weighted)
+			load_edges<WeightedEdgeUnit<uint32_t> >(file_path);
+		else
+			load_edges<EdgeUnit<uint32_t> >(file_path);
 	}
+}
 
+template<class KeyType, class ValueType>
+template<class UnitType>
+void Graph<KeyType, ValueType>::load_edges(char const *file_path)
+{
 	double time_start, time_end;
 	time_start = MPI_Wtime();
 
-	long total_bytes = file_size(file_path);
+	std::vector<std::string> shards;
+	if(!list_shards(file_path, shards))
+	{
+		fprintf(stderr, "Cannot open %s\n", file_path);
+		MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+	}
+	std::vector<UnitType> read_buffer;
+	read_shards(shards, read_buffer);
+	log("read time:%lf\n", MPI_Wtime() - time_start);
+
+	uint64_t max_id = 0;
+	#pragma omp parallel for num_threads(COMP_THREADS) reduction(max:max_id)
+	for (size_t i=0; i<read_buffer.size(); i++)
+		max_id = std::max(max_id, (uint64_t)std::max(read_buffer[i].src, read_buffer[i].dst));
+	MPI_Allreduce(MPI_IN_PLACE, &max_id, 1, MPI_UINT64_T, MPI_MAX, comm->mpi_comm);
+	if(max_id > (uint64_t)std::numeric_limits<KeyType>::max())
+	{
+		if(0 == rank)
+			fprintf(stderr, "Vertex id %llu exceeds the id type, compile with ID64=1\n", (unsigned long long)max_id);
+		MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+	}
 
-	num_edges = total_bytes / sizeof(EdgeUnit<KeyType, ValueType>);
-	EdgeUnit<KeyType, ValueType> *read_buffer = new EdgeUnit<KeyType, ValueType>[num_edges];
-	fin.read((char *)read_buffer, total_bytes);
+	shuffle_edges(read_buffer);
+	log("shuffle edges time:%lf\n", MPI_Wtime() - time_start);
 
 	KeyType src, dst;
+	WeightType weight;
 
-	// assign low degree vertices
-	for (unsigned long i=0; i<num_edges; i++)
+	/*
+		two passes over the edges: count the degrees of the local masters, then fill
+		nbr lists allocated to their exact sizes
+		masters of the current rank are indexed during loading by their slot in master_ids,
+		the sorted ids of the masters it received, so that the arrays do not grow with the id range
+		read_buffer holds the edges with src or dst at current rank
+	*/
+	std::vector<KeyType> master_ids;
+	for (size_t i=0; i<read_buffer.size(); i++)
+	{
+		// src is a master even if dst is not at current rank, as it is mirrored at the rank of dst
+		if(hash(read_buffer[i].src) == rank)
+			master_ids.push_back(read_buffer[i].src);
+		if(hash(read_buffer[i].dst) == rank)
+			master_ids.push_back(read_buffer[i].dst);
+	}
+	std::sort(master_ids.begin(), master_ids.end());
+	master_ids.erase(std::unique(master_ids.begin(), master_ids.end()), master_ids.end());
+	master_ids.shrink_to_fit();
+	size_t num_index = master_ids.size();
+	auto slot_of = [&master_ids](KeyType id) -> size_t
+	{
+		return std::lower_bound(master_ids.begin(), master_ids.end(), id) - master_ids.begin();
+	};
+
+	std::vector<uint32_t> in_degree(num_index, 0);
+	std::vector<uint32_t> out_degree(num_index, 0); // out nbrs on current rank only
+	#pragma omp parallel for num_threads(COMP_THREADS) private(src, dst)
+	for (size_t i=0; i<read_buffer.size(); i++)
 	{
 		src = read_buffer[i].src;
 		dst = read_buffer[i].dst;
-		int dst_rank = hash(dst);
-		if(rank == dst_rank)
-		{
-			// add dst: src -> dst
-			insert_vertex(low_degree_master, dst, default_value, src, true);
-			// auto ldma_it = low_degree_master.find(dst);
-			// if(low_degree_master.end() == ldma_it)
-			// {
-			// 	VertexType v(dst);
-			// 	v.add_in_nbr(src);
-			// 	low_degree_master.insert(std::make_pair(dst, v));
-			// }
-			// else
-			// 	(ldma_it->second).add_in_nbr(src);
-			
-			// add out nbrs: both src and dst are on current rank, add src -> dst
+		if(hash(dst) == rank && src != dst)
+		{
+			__sync_fetch_and_add(&in_degree[slot_of(dst)], 1);
 			if(hash(src) == rank)
-			{
-				insert_vertex(low_degree_master, src, default_value, dst, false);
-				// ldma_it = low_degree_master.find(src);
-				// if(low_degree_master.end() == ldma_it)
-				// {
-				// 	VertexType v(src);
-				// 	v.add_out_nbr(dst);
-				// 	low_degree_master.insert(std::make_pair(src, v));
-				// }
-				// else
-				// 	(ldma_it->second).add_out_nbr(dst);
-			}
-			// else
-			// {
-			// 	insert_vertex(low_degree_mirror, src, 0, dst, false);
-			// 	// auto ldmi_it = low_degree_mirror.find(src);
-			// 	// if(low_degree_mirror.end() == ldmi_it)
-			// 	// {
-			// 	// 	VertexType v(src);
-			// 	// 	v.add_out_nbr(dst);
-			// 	// 	low_degree_mirror.insert(std::make_pair(src, v));
-			// 	// }
-			// 	// else
-			// 	// 	(ldmi_it->second).add_out_nbr(dst);
-			// }
+				__sync_fetch_and_add(&out_degree[slot_of(src)], 1);
+		}
+	}
 
+	// assign low degree vertices
+	std::vector<VertexType *> master(num_index, NULL);
+	low_degree_master.reserve(num_index);
+	for (size_t index = 0; index < num_index; ++index)
+	{
+		KeyType id = master_ids[index];
+		VertexType &v = low_degree_master.emplace(std::piecewise_construct, std::forward_as_tuple(id), std::forward_as_tuple(id)).first->second;
+		v.get_in_nbr().resize(in_degree[index]);
+		v.get_out_nbr().resize(out_degree[index]);
+		if(weighted)
+		{
+			v.get_in_weight().resize(in_degree[index]);
+			v.get_out_weight().resize(out_degree[index]);
+		}
+		master[index] = &v;
+	}
+
+	// the degrees count down to the free slots, nbrs are in no particular order
+	#pragma omp parallel for num_threads(COMP_THREADS) private(src, dst, weight)
+	for (size_t i=0; i<read_buffer.size(); i++)
+	{
+		src = read_buffer[i].src;
+		dst = read_buffer[i].dst;
+		if(src == dst || hash(dst) != rank)
+			continue;
+		weight = edge_weight(read_buffer[i]);
+		size_t index = slot_of(dst);
+		VertexType *v = master[index];
+		uint32_t slot = __sync_sub_and_fetch(&in_degree[index], 1);
+		v->get_in_nbr()[slot] = src;
+		if(weighted)
+			v->get_in_weight()[slot] = weight;
+		if(hash(src) == rank)
+		{
+			index = slot_of(src);
+			v = master[index];
+			slot = __sync_sub_and_fetch(&out_degree[index], 1);
+			v->get_out_nbr()[slot] = dst;
+			if(weighted)
+				v->get_out_weight()[slot] = weight;
 		}
-		else
-			if(hash(src) == rank)
-			{
-				// add mirror for src: dst not at current rank & src at current rank, so src is mirror at dst_rank
-				insert_vertex(low_degree_master, src, default_value, src, true);
-				// insert_mirror(src, dst_rank);
-				// auto mirror_it = mirror.find(src);
-				// if(mirror.end() == mirror_it)
-				// {
-				// 	std::set<int> set;
-				// 	set.insert(dst_rank);
-				// 	mirror.insert(std::make_pair(src, set));
-				// }
-				// else
-				// 	(mirror_it->second).insert(dst_rank);
-			}
 	}
+	std::vector<uint32_t>().swap(in_degree);
 	
 	log("assign low degree time:%lf\n", MPI_Wtime() - time_start);
 
 	// reassign high degree vertices
-	// int mesg_num_send[size];
-	// int mesg_num_recv[size];
-	// memset(mesg_num_send, 0, sizeof(int) * size);
 	Sender<typename MesgBuf::EdgeMesg> *sender = new Sender<typename MesgBuf::EdgeMesg>(comm, EDGE);
 	for(auto ldma_it = low_degree_master.begin(); ldma_it != low_degree_master.end();)
 	{
-		auto &in_nbrs = (ldma_it->second).get_in_nbr();
-		// if(ldma_it->first == 5750)
-		// 	log("rank:%d, id: %d, in_nbrs:%d\n", rank, ldma_it->first, in_nbrs.size());
-		if(in_nbrs.size() > threshold)
+		if((ldma_it->second).get_in_nbr().size() > threshold)
 		{
 			KeyType dst = ldma_it->first;
-			ValueType dst_value = (ldma_it->second).get_value();
 
-			// high_active.insert(dst);
-			insert_vertex(high_degree_master, dst, default_value, dst, true);// in case no src at current rank
+			// the high degree master takes over the nbr lists, keeping the local in nbrs only
+			VertexType &v = high_degree_master.emplace(dst, ldma_it->second).first->second;
+			master[slot_of(dst)] = &v;
+			auto &in_nbrs = v.get_in_nbr();
 			
 			auto mirror_it = mirror.find(dst);
 			if(mirror.end() == mirror_it)
@@ -239,62 +529,40 @@ void Graph<KeyType, ValueType>::load(char const *file_path)
 				typename MesgBuf::EdgeMesg *bucket = sender->get_bucket(i);
 				bucket->src = dst;
 				bucket->dst = dst;
-				bucket->dst_value = dst_value;
-				// typename MesgBuf::EdgeMesg em = {dst, dst, dst_value};
-				// comm->send(i, EDGE, (void *)&em, sizeof(em));
-				// mesg_num_send[i]++;
 			}
 			
-			for(auto & src : in_nbrs)
+			size_t num_local = 0;
+			for(size_t j = 0; j < in_nbrs.size(); ++j)
 			{
+				KeyType src = in_nbrs[j];
+				WeightType weight = weighted ? v.get_in_weight()[j] : 1;
 				int src_rank = hash(src);
 				if(src_rank == rank)
 				{
-					// add vertex to high degree master
-					insert_vertex(high_degree_master, dst, default_value, src, true);
-					// auto &out_nbrs = (ldma_it->second).get_out_nbr();
-					// if(dst == 0)
-					// 	printf("Note:0 have %d\n", out_nbrs.size());
-
-					(high_degree_master.find(dst)->second).get_out_nbr() = ((ldma_it->second).get_out_nbr());
-					// (high_degree_master.find(dst)->second).get_out_nbr() = std::move((ldma_it->second).get_out_nbr());
-					// out_nbrs = (high_degree_master.find(dst)->second).get_out_nbr();
-					// if(dst == 0)
-					// 	printf("Note:0 have %d\n", (high_degree_master.find(dst)->second).get_out_nbr().size());
-
-					// auto it = high_degree_master.find(dst);
-					// if(it == high_degree_master.end())
-					// {
-					// 	VertexType v(dst);
-					// 	v.add_in_nbr(src);
-					// 	high_degree_master.insert(std::make_pair(dst, v));
-					// }
-					// else
-					// 	(it->second).add_in_nbr(src);
+					in_nbrs[num_local] = src;
+					if(weighted)
+						v.get_in_weight()[num_local] = weight;
+					num_local++;
 				}
 				else
 				{
 					// src at other rank, add mirror
 					(mirror_it->second).insert(src_rank);
-					//ValueType src_value = ((low_degree_mirror.find(src))->second).get_value();
-					//double temp = MPI_Wtime();
 					typename MesgBuf::EdgeMesg *bucket = sender->get_bucket(src_rank);
 					bucket->src = src;
 					bucket->dst = dst;
-					bucket->dst_value = dst_value;
-					// typename MesgBuf::EdgeMesg em = {src, dst, dst_value};
-					// comm->send(src_rank, EDGE, (void *)&em, sizeof(em));
-					// mesg_num_send[src_rank]++;
-
-					//log("Send edge time %lf\n", MPI_Wtime() - temp);
-					// double temp = MPI_Wtime();
-					// typename MesgBuf::SyncMesg sync_mesg = {src, dst_value};
-					// comm->send(src_rank, SYNC_MASTER, (void *)&sync_mesg, sizeof(sync_mesg));
-					// log("Test send time %lf\n", MPI_Wtime() - temp);
+					bucket->weight = weight;
 				}
 			}
+			in_nbrs.resize(num_local);
+			in_nbrs.shrink_to_fit();
+			if(weighted)
+			{
+				v.get_in_weight().resize(num_local);
+				v.get_in_weight().shrink_to_fit();
+			}
 
-			// delete the original vertex
+			// delete the original vertex, its nbr lists now belong to the high degree master
 			ldma_it = low_degree_master.erase(ldma_it);
 		}
 		else
@@ -305,46 +573,69 @@ void Graph<KeyType, ValueType>::load(char const *file_path)
 	delete sender;
 	MPI_Barrier(comm->mpi_comm);
 	while(comm->is_receiving());
-	// MPI_Alltoall(mesg_num_send, 1, MPI_INT, mesg_num_recv, 1, MPI_INT, comm->mpi_comm);
-	// int sum = 0;
-	// for (int i = 0; i < size; i++)
-	// 	sum += mesg_num_recv[i];
-	// while(mesg_buf->buf_size != sum);
 
 	log("reassign high degree time:%lf\n", MPI_Wtime() - time_start);
 
 	/*
 		receive high degree mirror from other ranks
+		count the new nbrs first so that every list grows once
 	*/
-	// log("Rank:%d, Size:%d\n", comm->get_rank(), (mesg_buf->get_edge_buf()).size());
+	std::unordered_map<KeyType, uint32_t> mirror_degree;
 	for(auto block_ptr : mesg_buf->get_edge_buf())
 	{
-		int buf_size = block_ptr->id;
-		for (int i = 1; i < buf_size + 1; i++)
+		size_t buf_size = block_ptr->id;
+		for (size_t i = 1; i < buf_size + 1; i++)
 		{
 			auto edge_ptr = block_ptr + i;
-			insert_vertex(high_degree_mirror, edge_ptr->dst, edge_ptr->dst_value, edge_ptr->src, true);
+			uint32_t &degree = mirror_degree[edge_ptr->dst];
 			if(edge_ptr->dst != edge_ptr->src)
 			{
-				if(high_degree_master.end() != high_degree_master.find(edge_ptr->src))
-					insert_vertex(high_degree_master, edge_ptr->src, default_value, edge_ptr->dst, false);
-				else
-					if(low_degree_master.end() != low_degree_master.find(edge_ptr->src))
-						insert_vertex(low_degree_master, edge_ptr->src, default_value, edge_ptr->dst, false);
-					else
-					{
-						log("Failed insert mirror, rank:%d dst: %d, src:%d, dst_value:%d\n", rank, edge_ptr->dst, edge_ptr->src, edge_ptr->dst_value);
-						exit(0);
-					}
+				degree++;
+				size_t index = slot_of(edge_ptr->src);
+				if(index >= num_index || master_ids[index] != edge_ptr->src)
+				{
+					log("Failed insert mirror, rank:%d dst: %lu, src:%lu\n", rank, (unsigned long)edge_ptr->dst, (unsigned long)edge_ptr->src);
+					exit(0);
+				}
+				out_degree[index]++;
 			}
 		}
-		free(block_ptr);
-		// free(edge_ptr);
-		// high_active.insert(edge_ptr->dst); // insert into active set
+	}
+	high_degree_mirror.reserve(mirror_degree.size());
+	for(auto &pair : mirror_degree)
+	{
+		VertexType &v = high_degree_mirror.emplace(std::piecewise_construct, std::forward_as_tuple(pair.first), std::forward_as_tuple(pair.first)).first->second;
+		reserve_nbr(v, pair.second, true);
+	}
+	for (size_t index = 0; index < num_index; ++index)
+		if(out_degree[index])
+			reserve_nbr(*master[index], out_degree[index], false);
+	std::vector<uint32_t>().swap(out_degree);
 
+	for(auto block_ptr : mesg_buf->get_edge_buf())
+	{
+		size_t buf_size = block_ptr->id;
+		for (size_t i = 1; i < buf_size + 1; i++)
+		{
+			auto edge_ptr = block_ptr + i;
+			VertexType &v = high_degree_mirror.find(edge_ptr->dst)->second;
+			if(edge_ptr->dst != edge_ptr->src)
+			{
+				v.add_in_nbr(edge_ptr->src);
+				VertexType *src_v = master[slot_of(edge_ptr->src)];
+				src_v->add_out_nbr(edge_ptr->dst);
+				if(weighted)
+				{
+					v.get_in_weight().push_back(edge_ptr->weight);
+					src_v->get_out_weight().push_back(edge_ptr->weight);
+				}
+			}
+		}
+		free(block_ptr);
 	}
-	// log("Rank:%d, Size:%d\n", comm->get_rank(), (mesg_buf->get_edge_buf()).size());
 	(mesg_buf->get_edge_buf()).clear();
+	std::vector<VertexType *>().swap(master);
+	std::vector<KeyType>().swap(master_ids);
 
 	log("receive high degree time:%lf\n", MPI_Wtime() - time_start);
 
@@ -352,39 +643,45 @@ void Graph<KeyType, ValueType>::load(char const *file_path)
 		initialize low degree mirror
 		add out nbrs
 	*/
+	mirror_degree.clear();
+	for(auto & pair : low_degree_master)
+		for(auto src : pair.second.get_in_nbr())
+			if(hash(src) != rank)
+				mirror_degree[src]++;
+	low_degree_mirror.reserve(mirror_degree.size());
+	for(auto &pair : mirror_degree)
+	{
+		auto hdmi_it = high_degree_mirror.find(pair.first);
+		if(high_degree_mirror.end() != hdmi_it)
+			reserve_nbr(hdmi_it->second, pair.second, false);
+		else
+		{
+			VertexType &v = low_degree_mirror.emplace(std::piecewise_construct, std::forward_as_tuple(pair.first), std::forward_as_tuple(pair.first)).first->second;
+			reserve_nbr(v, pair.second, false);
+		}
+	}
+	std::unordered_map<KeyType, uint32_t>().swap(mirror_degree);
+
 	for(auto & pair : low_degree_master)
 	{
 		KeyType	dst = pair.first;
-		// low_active_master.insert(dst); // insert into active set
 		auto &in_nbrs = pair.second.get_in_nbr();
-		for(auto & src : in_nbrs)
+		for(size_t j = 0; j < in_nbrs.size(); ++j)
 		{
+			KeyType src = in_nbrs[j];
+			WeightType weight = weighted ? pair.second.get_in_weight()[j] : 1;
 			if(hash(src) != rank)
 			{
 				if(high_degree_mirror.end() == high_degree_mirror.find(src))
-				{
-					// low_active_mirror.insert(src); // insert into active set
-					insert_vertex(low_degree_mirror, src, default_value, dst, false);
-					// auto ldmi_it = low_degree_mirror.find(src);
-					// if(low_degree_mirror.end() != ldmi_it)
-					// {
-					// 	VertexType v(src);
-					// 	v.add_out_nbr(dst);
-					// 	low_degree_mirror.insert(std::make_pair(src, v));
-					// }
-					// else
-					// 	(ldmi_it->second).add_out_nbr(dst);
-				}
+					insert_vertex(low_degree_mirror, src, dst, weight, false);
 				else
-				{
-					insert_vertex(high_degree_mirror, src, default_value, dst ,false);
-				}
+					insert_vertex(high_degree_mirror, src, dst, weight, false);
 			}
 		}
 	}
 	log("initialize low degree mirror time:%lf\n", MPI_Wtime() - time_start);
 
-	for (unsigned long i=0; i<num_edges; i++)
+	for (size_t i=0; i<read_buffer.size(); i++)
 	{
 		src = read_buffer[i].src;
 		dst = read_buffer[i].dst;
@@ -392,64 +689,195 @@ void Graph<KeyType, ValueType>::load(char const *file_path)
 		if((rank != dst_rank) && (hash(src) == rank) && (high_degree_mirror.end() == high_degree_mirror.find(dst)))
 			insert_mirror(src, dst_rank);
 	}
-	delete []read_buffer;
+	std::vector<UnitType>().swap(read_buffer);
 	
-	init_map();
+	/*
+		order[0..3]: low master, low mirror, high master, high mirror
+	*/
+	std::vector<KeyType> order[4];
+	double reorder_start = MPI_Wtime();
+	compute_order(order);
+	log("reorder time:%lf\n", MPI_Wtime() - reorder_start);
+	init_map(order);
 
 
 	time_end = MPI_Wtime();
 	log("loading time: %lf\n", time_end - time_start);
 	MPI_Barrier(comm->mpi_comm);
 
-	fin.close();
-
 	log("rank: %d, low master Vertices: %d\n", rank, low_degree_master.size());
 	log("rank: %d, high master Vertices: %d\n", rank, high_degree_master.size());
 	log("rank: %d, low mirror Vertices: %d\n", rank, low_degree_mirror.size());
 	log("rank: %d, high mirror Vertices: %d\n", rank, high_degree_mirror.size());
 
-	unsigned long local_v[4] = {low_degree_master.size(), high_degree_master.size(), low_degree_mirror.size(), high_degree_mirror.size()};
-	unsigned long global_v[4];
-	MPI_Reduce(&local_v, &global_v, 4, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
+	unsigned long local_v[5] = {low_degree_master.size(), high_degree_master.size(), low_degree_mirror.size(), high_degree_mirror.size(), num_local_only};
+	unsigned long global_v[5];
+	MPI_Reduce(&local_v, &global_v, 5, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
 	if(0 == rank) {
-		printf("low master:%ld, high master:%ld, low mirror:%ld, high mirror:%ld, Total mirror:%ld\n", global_v[0], global_v[1],
-		 global_v[2], global_v[3], global_v[2] + global_v[3]);
+		printf("low master:%ld, high master:%ld, low mirror:%ld, high mirror:%ld, Total mirror:%ld, Local only master:%ld\n", global_v[0], global_v[1],
+		 global_v[2], global_v[3], global_v[2] + global_v[3], global_v[4]);
 		printf("Loading time: %lf (s)\n", MPI_Wtime()-time_start);
 	}
 }
 
+/*
+	read the share of the current rank from the concatenation of the shards
+	the edges are split evenly among the ranks at page aligned offsets of the concatenation
+*/
 template<class KeyType, class ValueType>
-inline void Graph<KeyType, ValueType>::insert_vertex(VertexContainer &vertex_container, KeyType id, ValueType value, KeyType nbr, bool is_in)
+template<class UnitType>
+void Graph<KeyType, ValueType>::read_shards(std::vector<std::string> &shards, std::vector<UnitType> &buffer)
 {
-	auto vc_it = vertex_container.find(id);
-	
-	if(vertex_container.end() == vc_it)
+	// first edge of each shard
+	std::vector<unsigned long> first(shards.size() + 1, 0);
+	for (size_t i = 0; i < shards.size(); ++i)
 	{
-		VertexType v = VertexType(id, value);
-		
-		// not broadcast init
-		if(id != nbr)
+		long bytes = file_size(shards[i].c_str());
+		if(bytes % sizeof(UnitType))
 		{
-			if(is_in)
-				v.add_in_nbr(nbr);
-			else
-				v.add_out_nbr(nbr);
+			fprintf(stderr, "Size of %s is not a multiple of the edge size\n", shards[i].c_str());
+			MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
 		}
+		first[i + 1] = first[i] + bytes / sizeof(UnitType);
+	}
+	num_edges = first.back();
 
-		vertex_container.insert(std::make_pair(id, v));
+	// smallest number of edges spanning whole pages
+	unsigned long align = 4096 / (sizeof(UnitType) & (~sizeof(UnitType) + 1));
+	unsigned long begin = num_edges * rank / size / align * align;
+	unsigned long end = (rank == size - 1) ? num_edges : num_edges * (rank + 1) / size / align * align;
+	buffer.resize(end - begin);
+
+	char *ptr = (char *)buffer.data();
+	for (size_t i = 0; i < shards.size(); ++i)
+	{
+		if(first[i + 1] <= begin || first[i] >= end)
+			continue;
+		int fd = open(shards[i].c_str(), O_RDONLY);
+		if(fd < 0)
+		{
+			fprintf(stderr, "Cannot open %s\n", shards[i].c_str());
+			MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+		}
+		off_t offset = (std::max(begin, first[i]) - first[i]) * sizeof(UnitType);
+		off_t offset_end = (std::min(end, first[i + 1]) - first[i]) * sizeof(UnitType);
+		posix_fadvise(fd, offset, offset_end - offset, POSIX_FADV_SEQUENTIAL);
+		while(offset < offset_end)
+		{
+			ssize_t bytes = pread(fd, ptr, std::min((size_t)(offset_end - offset), READ_CHUNK), offset);
+			if(bytes <= 0)
+			{
+				fprintf(stderr, "Cannot read %s\n", shards[i].c_str());
+				MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+			}
+			ptr += bytes;
+			offset += bytes;
+		}
+		close(fd);
 	}
-	else
+}
+
+/*
+	send every edge to the ranks of its src and dst
+	afterwards buffer holds the edges with src or dst at current rank
+*/
+template<class KeyType, class ValueType>
+template<class UnitType>
+void Graph<KeyType, ValueType>::shuffle_edges(std::vector<UnitType> &buffer)
+{
+	if(1 == size)
+		return;
+
+	Sender<typename MesgBuf::EdgeMesg> *sender = new Sender<typename MesgBuf::EdgeMesg>(comm, EDGE);
+	size_t num_local = 0;
+	for (size_t i = 0; i < buffer.size(); ++i)
 	{
-		if(id != nbr)
+		UnitType edge = buffer[i];
+		int src_rank = hash(edge.src);
+		int dst_rank = hash(edge.dst);
+		for (int target : {src_rank, dst_rank})
 		{
-			if(is_in)
-				(vc_it->second).add_in_nbr(nbr);
-			else
-				(vc_it->second).add_out_nbr(nbr);
+			if(target == rank)
+				continue;
+			typename MesgBuf::EdgeMesg *bucket = sender->get_bucket(target);
+			bucket->src = edge.src;
+			bucket->dst = edge.dst;
+			bucket->weight = edge_weight(edge);
+			if(src_rank == dst_rank)
+				break;
+		}
+		if(src_rank == rank || dst_rank == rank)
+			buffer[num_local++] = edge;
+	}
+	sender->flush();
+	delete sender;
+	MPI_Barrier(comm->mpi_comm);
+	while(comm->is_receiving());
+
+	size_t num_recv = 0;
+	for(auto block_ptr : mesg_buf->get_edge_buf())
+		num_recv += block_ptr->id;
+	buffer.resize(num_local);
+	buffer.reserve(num_local + num_recv);
+	for(auto block_ptr : mesg_buf->get_edge_buf())
+	{
+		size_t buf_size = block_ptr->id;
+		for (size_t i = 1; i < buf_size + 1; i++)
+		{
+			UnitType edge;
+			edge.src = block_ptr[i].src;
+			edge.dst = block_ptr[i].dst;
+			set_edge_weight(edge, block_ptr[i].weight);
+			buffer.push_back(edge);
+		}
+		free(block_ptr);
+	}
+	(mesg_buf->get_edge_buf()).clear();
+	// the high degree vertices are reassigned with the same tag, a rank done early must not send them
+	// into the edges of a rank still collecting these
+	MPI_Barrier(comm->mpi_comm);
+}
+
+template<class KeyType, class ValueType>
+inline void Graph<KeyType, ValueType>::insert_vertex(VertexContainer &vertex_container, KeyType id, KeyType nbr, WeightType weight, bool is_in)
+{
+	auto vc_it = vertex_container.find(id);
+	
+	if(vertex_container.end() == vc_it)
+		vc_it = vertex_container.emplace(std::piecewise_construct, std::forward_as_tuple(id), std::forward_as_tuple(id)).first;
+
+	// not broadcast init
+	if(id != nbr)
+	{
+		VertexType &v = vc_it->second;
+		if(is_in)
+		{
+			v.add_in_nbr(nbr);
+			if(weighted)
+				v.get_in_weight().push_back(weight);
+		}
+		else
+		{
+			v.add_out_nbr(nbr);
+			if(weighted)
+				v.get_out_weight().push_back(weight);
 		}
 	}
 }
 
+// make room for num more in or out nbrs
+template<class KeyType, class ValueType>
+inline void Graph<KeyType, ValueType>::reserve_nbr(VertexType &v, size_t num, bool is_in)
+{
+	auto &nbrs = is_in ? v.get_in_nbr() : v.get_out_nbr();
+	nbrs.reserve(nbrs.size() + num);
+	if(weighted)
+	{
+		auto &weights = is_in ? v.get_in_weight() : v.get_out_weight();
+		weights.reserve(weights.size() + num);
+	}
+}
+
 template<class KeyType, class ValueType>
 inline void Graph<KeyType, ValueType>::insert_mirror(KeyType &id, int rank)
 {
@@ -493,94 +921,221 @@ inline bool Graph<KeyType, ValueType>::insert_active_master(KeyType id)
 {
 	if(high_degree_master.end() != high_degree_master.find(id))
 	{
-		KeyType lid = gtol_high_master[id];
+		LocalId lid = gtol_high_master[id];
 		return high_active_master.set_bit(lid);
 	}
 	else
 	{
-		KeyType lid = gtol_low_master[id];
+		LocalId lid = gtol_low_master[id];
 		return low_active_master.set_bit(lid);
 	}
 }
 
+/*
+	activations are sent to every rank, which may have no mirror of the vertex, nothing is set then
+	(the worker threads call it concurrently, so the maps must not be inserted into)
+*/
 template<class KeyType, class ValueType>
 inline bool Graph<KeyType, ValueType>::insert_active_mirror(KeyType id)
 {
 	if(high_degree_mirror.end() != high_degree_mirror.find(id))
 	{
-		KeyType lid = gtol_high_mirror[id];
+		LocalId lid = gtol_high_mirror[id];
 		return high_active_mirror.set_bit(lid);
 	}
-	else
+	auto it = gtol_low_mirror.find(id);
+	if(gtol_low_mirror.end() == it)
+		return true;
+	return low_active_mirror.set_bit(it->second);
+}
+
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::compute_order(std::vector<KeyType> order[])
+{
+	VertexContainer *containers[4] = {&low_degree_master, &low_degree_mirror, &high_degree_master, &high_degree_mirror};
+
+	if(REORDER_NONE == reorder_type)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			order[c].reserve(containers[c]->size());
+			for(auto &pair : *containers[c])
+				order[c].push_back(pair.first);
+		}
+		return;
+	}
+
+	/*
+		unified index over all local vertices, so that vertices of different
+		types which are neighbors end up with correlated local ids
+	*/
+	std::vector<KeyType> ids;
+	std::vector<int> types;
+	std::vector<size_t> degree;
+	std::unordered_map<KeyType, size_t> index;
+	for (int c = 0; c < 4; ++c)
+	{
+		for(auto &pair : *containers[c])
+		{
+			index[pair.first] = ids.size();
+			ids.push_back(pair.first);
+			types.push_back(c);
+			degree.push_back(pair.second.get_in_nbr().size() + pair.second.get_out_nbr().size());
+		}
+	}
+	size_t n = ids.size();
+	std::vector<size_t> sequence;
+	sequence.reserve(n);
+
+	if(REORDER_HUB == reorder_type)
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < n; ++i)
+			total += degree[i];
+		double average = n ? (double)total / n : 0;
+		for (size_t i = 0; i < n; ++i)
+			if(degree[i] > average)
+				sequence.push_back(i);
+		std::stable_sort(sequence.begin(), sequence.end(), [&](size_t x, size_t y) {return degree[x] > degree[y];});
+		for (size_t i = 0; i < n; ++i)
+			if(degree[i] <= average)
+				sequence.push_back(i);
+	}
+	else // REORDER_RCM
 	{
-		KeyType lid = gtol_low_mirror[id];
-		return low_active_mirror.set_bit(lid);
+		std::vector<size_t> by_degree(n);
+		for (size_t i = 0; i < n; ++i)
+			by_degree[i] = i;
+		std::stable_sort(by_degree.begin(), by_degree.end(), [&](size_t x, size_t y) {return degree[x] < degree[y];});
+
+		std::vector<bool> visited(n, false);
+		std::vector<size_t> nbrs;
+		for(auto root : by_degree)
+		{
+			if(visited[root])
+				continue;
+			visited[root] = true;
+			size_t head = sequence.size();
+			sequence.push_back(root);
+			// BFS, visiting unvisited neighbors in increasing degree order
+			while(head < sequence.size())
+			{
+				VertexType &v = containers[types[sequence[head]]]->find(ids[sequence[head]])->second;
+				head++;
+				nbrs.clear();
+				for (int dir = 0; dir < 2; ++dir)
+				{
+					for(auto nbr : (0 == dir) ? v.get_in_nbr() : v.get_out_nbr())
+					{
+						auto index_it = index.find(nbr);
+						if(index.end() == index_it || visited[index_it->second])
+							continue;
+						visited[index_it->second] = true;
+						nbrs.push_back(index_it->second);
+					}
+				}
+				std::sort(nbrs.begin(), nbrs.end(), [&](size_t x, size_t y) {return degree[x] < degree[y];});
+				sequence.insert(sequence.end(), nbrs.begin(), nbrs.end());
+			}
+		}
+		std::reverse(sequence.begin(), sequence.end());
 	}
+
+	for(auto i : sequence)
+		order[types[i]].push_back(ids[i]);
+
+	#pragma omp parallel for num_threads(4)
+	for (int c = 0; c < 4; ++c)
+		relocate(*containers[c], order[c]);
+}
+
+/*
+	rebuild the container in the new order, so that vertices are allocated
+	(and therefore laid out in memory) following their local ids
+*/
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::relocate(VertexContainer &vertex_container, std::vector<KeyType> &order)
+{
+	VertexContainer relocated;
+	relocated.reserve(vertex_container.size());
+	for(auto id : order)
+		relocated.insert(std::make_pair(id, std::move(vertex_container.find(id)->second)));
+	vertex_container.swap(relocated);
 }
 
 template<class KeyType, class ValueType>
-void Graph<KeyType, ValueType>::init_map()
+void Graph<KeyType, ValueType>::init_map(std::vector<KeyType> order[])
 {
 	#pragma omp parallel sections num_threads(4)
 	{
 		#pragma omp section
 		{
-			KeyType low_master_index = 0;
-			low_active_master.init(low_degree_master.size());
-			for(auto &pair : low_degree_master)
-			{
-				KeyType id = pair.first;
-				gtol_low_master[id] = low_master_index;
-				ltog_low_master[low_master_index] = id;
-				// low_active_master.set_bit(low_master_index);
-				low_master_index++;
-			}
+			init_map(low_degree_master, order[0], low_active_master, gtol_low_master, ltog_low_master, ltov_low_master);
 		}
 		#pragma omp section
 		{
-			KeyType low_mirror_index = 0;
-			low_active_mirror.init(low_degree_mirror.size());
-			for(auto &pair : low_degree_mirror)
-			{
-				KeyType id = pair.first;
-				gtol_low_mirror[id] = low_mirror_index;
-				ltog_low_mirror[low_mirror_index] = id;
-				// low_active_mirror.set_bit(low_mirror_index);
-				low_mirror_index++;
-			}
+			init_map(low_degree_mirror, order[1], low_active_mirror, gtol_low_mirror, ltog_low_mirror, ltov_low_mirror);
 		}
 		#pragma omp section
 		{
-			KeyType high_master_index = 0;
-			high_active_master.init(high_degree_master.size());
-			for(auto &pair : high_degree_master)
-			{
-				KeyType id = pair.first;
-				gtol_high_master[id] = high_master_index;
-				ltog_high_master[high_master_index] = id;
-				// high_active_master.set_bit(high_master_index);
-				high_master_index++;
-			}
+			init_map(high_degree_master, order[2], high_active_master, gtol_high_master, ltog_high_master, ltov_high_master);
 		}
 		#pragma omp section
 		{
-			KeyType high_mirror_index = 0;
-			high_active_mirror.init(high_degree_mirror.size());
-			for(auto &pair : high_degree_mirror)
-			{
-				KeyType id = pair.first;
-				gtol_high_mirror[id] = high_mirror_index;
-				ltog_high_mirror[high_mirror_index] = id;
-				// high_active_mirror.set_bit(high_mirror_index);
-				high_mirror_index++;
-			}
+			init_map(high_degree_mirror, order[3], high_active_mirror, gtol_high_mirror, ltog_high_mirror, ltov_high_mirror);
 		}
 	}
+
+	local_vertex.reserve(ltov_low_master.size() + ltov_low_mirror.size() + ltov_high_master.size() + ltov_high_mirror.size());
+	local_vertex.insert(local_vertex.end(), ltov_low_master.begin(), ltov_low_master.end());
+	local_vertex.insert(local_vertex.end(), ltov_low_mirror.begin(), ltov_low_mirror.end());
+	local_vertex.insert(local_vertex.end(), ltov_high_master.begin(), ltov_high_master.end());
+	local_vertex.insert(local_vertex.end(), ltov_high_mirror.begin(), ltov_high_mirror.end());
+	vertex_state.assign(local_vertex.size(), default_value);
+	for (size_t i = 0; i < local_vertex.size(); ++i)
+	{
+		local_vertex[i]->index = i;
+		local_vertex[i]->set_state(&vertex_state);
+	}
+	num_local_only = 0;
+	for(auto v : local_vertex)
+	{
+		v->replicated = (hash(v->get_id()) != rank) || (mirror.end() != mirror.find(v->get_id()));
+		if(!v->replicated)
+			num_local_only++;
+	}
+}
+
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::init_map(VertexContainer &vertex_container, std::vector<KeyType> &order, BitMap &active,
+	std::unordered_map<KeyType, LocalId> &gtol, std::unordered_map<LocalId, KeyType> &ltog, std::vector<VertexType *> &ltov)
+{
+	LocalId index = 0;
+	active.init(vertex_container.size());
+	ltov.resize(vertex_container.size());
+	for(auto id : order)
+	{
+		gtol[id] = index;
+		ltog[index] = id;
+		ltov[index] = &(vertex_container.find(id)->second);
+		index++;
+	}
 }
 
 template<class KeyType, class ValueType>
-void Graph<KeyType, ValueType>::transform_vertices(bool (*init_fun)(VertexType &v))
+void Graph<KeyType, ValueType>::transform_vertices(bool (*init_fun)(VertexType &v), const char *prior)
 {
+	if(weighted)
+	{
+		size_t num_local_edges = 0;
+		for(auto v : local_vertex)
+		{
+			v->edge_offset = num_local_edges;
+			num_local_edges += v->get_in_nbr().size() + v->get_out_nbr().size();
+		}
+		edge_weights.resize(num_local_edges);
+	}
+
 	#pragma omp parallel sections num_threads(4)
 	{
 		#pragma omp section
@@ -624,16 +1179,1140 @@ void Graph<KeyType, ValueType>::transform_vertices(bool (*init_fun)(VertexType &
 			}
 		}
 	}
+
+	unsigned long local_bytes = 0, global_bytes;
+	for(auto v : local_vertex)
+	{
+		if(compressed)
+			local_bytes += v->in_nbrs_c.memory() + v->out_nbrs_c.memory();
+		else
+			local_bytes += (v->in_nbrs_i.capacity() + v->out_nbrs_i.capacity()) * sizeof(LocalId);
+	}
+	MPI_Reduce(&local_bytes, &global_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
+	if(0 == rank)
+		printf("Adjacency size: %lf (MB)%s\n", global_bytes / 1048576.0, compressed ? " compressed" : "");
+
+	if(prior)
+		warm_start(prior);
 }
 
 template<class KeyType, class ValueType>
-void Graph<KeyType, ValueType>::init_nbr_ptr(VertexType &v)
+void Graph<KeyType, ValueType>::reset_vertices(bool (*init_fun)(VertexType &v))
 {
-	for(auto in_nbr : v.get_in_nbr())
-		v.in_nbrs_v.push_back(&find_vertex(in_nbr));
-	for(auto out_nbr : v.get_out_nbr())
-		v.out_nbrs_v.push_back(&find_vertex(out_nbr));
-	v.clear_nbr_vec(); // free the nbr vector which would be unused
+	low_active_master.clear();
+	low_active_mirror.clear();
+	high_active_master.clear();
+	high_active_mirror.clear();
+
+	std::fill(vertex_state.change.begin(), vertex_state.change.end(), ValueType());
+	// set by the scatters of the last run, they would keep the vertices from being activated
+	std::fill(vertex_state.active.begin(), vertex_state.active.end(), 0);
+	#pragma omp parallel for num_threads(COMP_THREADS)
+	for(size_t i = 0; i < local_vertex.size(); ++i)
+		if(init_fun(*local_vertex[i]))
+			set_active(i);
+	// no rank starts the next run while another may still send from the last one
+	MPI_Barrier(comm->mpi_comm);
+}
+
+// set the active bit of local_vertex[index]
+template<class KeyType, class ValueType>
+inline void Graph<KeyType, ValueType>::set_active(size_t index)
+{
+	// local_vertex holds the low masters, low mirrors, high masters and high mirrors in this order
+	if(index < ltov_low_master.size())
+	{
+		low_active_master.set_bit(index);
+		return;
+	}
+	index -= ltov_low_master.size();
+	if(index < ltov_low_mirror.size())
+	{
+		low_active_mirror.set_bit(index);
+		return;
+	}
+	index -= ltov_low_mirror.size();
+	if(index < ltov_high_master.size())
+		high_active_master.set_bit(index);
+	else
+		high_active_mirror.set_bit(index - ltov_high_master.size());
+}
+
+// the active bit of local_vertex[index]
+template<class KeyType, class ValueType>
+inline bool Graph<KeyType, ValueType>::get_active(size_t index)
+{
+	if(index < ltov_low_master.size())
+		return low_active_master.get_bit(index);
+	index -= ltov_low_master.size();
+	if(index < ltov_low_mirror.size())
+		return low_active_mirror.get_bit(index);
+	index -= ltov_low_mirror.size();
+	if(index < ltov_high_master.size())
+		return high_active_master.get_bit(index);
+	return high_active_mirror.get_bit(index - ltov_high_master.size());
+}
+
+template<class KeyType, class ValueType>
+double Graph<KeyType, ValueType>::mean_edge_weight()
+{
+	// every edge is held once as an in edge and once as an out edge
+	double local[2] = {0, (double)edge_weights.size()}, global[2];
+	for(auto weight : edge_weights)
+		local[0] += weight;
+	MPI_Allreduce(local, global, 2, MPI_DOUBLE, MPI_SUM, comm->mpi_comm);
+	return global[1] > 0 ? global[0] / global[1] : 1;
+}
+
+/*
+	out[r] is sent to rank r, in receives the elements of every rank in rank order, collective
+	the elements go in rounds of at most 1 GB per rank, so that the byte counts and displacements fit the ints of MPI
+*/
+template<class KeyType, class ValueType>
+template<class T>
+void Graph<KeyType, ValueType>::exchange(std::vector<std::vector<T> > &out, std::vector<T> &in)
+{
+	// counted in bytes, T is trivially copyable
+	const size_t chunk = std::max((size_t)1, ((size_t)1 << 30) / size / sizeof(T));
+	unsigned long long num_rounds = 0, max_rounds;
+	for (int i = 0; i < size; ++i)
+		num_rounds = std::max(num_rounds, (unsigned long long)((out[i].size() + chunk - 1) / chunk));
+	MPI_Allreduce(&num_rounds, &max_rounds, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm->mpi_comm);
+
+	std::vector<std::vector<T> > from(size);
+	std::vector<int> send_counts(size), recv_counts(size), send_displs(size), recv_displs(size);
+	std::vector<T> send_buf, recv_buf;
+	for (size_t round = 0; round < max_rounds; ++round)
+	{
+		send_buf.clear();
+		for (int i = 0; i < size; ++i)
+		{
+			size_t first = std::min(out[i].size(), round * chunk);
+			size_t last = std::min(out[i].size(), first + chunk);
+			send_displs[i] = send_buf.size() * sizeof(T);
+			send_counts[i] = (last - first) * sizeof(T);
+			send_buf.insert(send_buf.end(), out[i].begin() + first, out[i].begin() + last);
+		}
+		MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm->mpi_comm);
+		size_t bytes = 0;
+		for (int i = 0; i < size; ++i)
+		{
+			recv_displs[i] = bytes;
+			bytes += recv_counts[i];
+		}
+		if(bytes > INT_MAX)
+		{
+			fprintf(stderr, "Rank: %d, %lu bytes exceed a round of the exchange\n", rank, bytes);
+			MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+		}
+		recv_buf.resize(bytes / sizeof(T));
+		MPI_Alltoallv(send_buf.data(), send_counts.data(), send_displs.data(), MPI_BYTE,
+			recv_buf.data(), recv_counts.data(), recv_displs.data(), MPI_BYTE, comm->mpi_comm);
+		for (int i = 0; i < size; ++i)
+			from[i].insert(from[i].end(), recv_buf.begin() + recv_displs[i] / sizeof(T), recv_buf.begin() + (recv_displs[i] + recv_counts[i]) / sizeof(T));
+	}
+
+	size_t total = 0;
+	for (int i = 0; i < size; ++i)
+		total += from[i].size();
+	in.clear();
+	in.reserve(total);
+	for (int i = 0; i < size; ++i)
+		in.insert(in.end(), from[i].begin(), from[i].end());
+}
+
+/*
+	fingerprint of the adjacency of every master, indexed like local_vertex, see edge_hash()
+	the mirrors send the sums over their edges to the masters, collective
+*/
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::adjacency_fingerprints(std::vector<uint64_t> &fingerprint)
+{
+	fingerprint.assign(local_vertex.size(), 0);
+	#pragma omp parallel for num_threads(COMP_THREADS)
+	for (size_t i = 0; i < local_vertex.size(); ++i)
+	{
+		VertexType &v = *local_vertex[i];
+		uint64_t sum = 0;
+		for_each_in_nbr(v, [&](VertexType *nbr, WeightType weight) {sum += edge_hash(nbr->get_id(), weight, false);});
+		for_each_out_nbr(v, [&](VertexType *nbr, WeightType weight) {sum += edge_hash(nbr->get_id(), weight, true);});
+		fingerprint[i] = sum;
+	}
+
+	const size_t record = sizeof(KeyType) + sizeof(uint64_t);
+	std::vector<std::vector<char> > out(size);
+	for (size_t i = 0; i < local_vertex.size(); ++i)
+	{
+		KeyType id = local_vertex[i]->get_id();
+		if(hash(id) == rank)
+			continue;
+		std::vector<char> &buf = out[hash(id)];
+		buf.resize(buf.size() + record);
+		memcpy(buf.data() + buf.size() - record, &id, sizeof(KeyType));
+		memcpy(buf.data() + buf.size() - sizeof(uint64_t), &fingerprint[i], sizeof(uint64_t));
+	}
+	std::vector<char> in;
+	exchange(out, in);
+	for (size_t pos = 0; pos < in.size(); pos += record)
+	{
+		KeyType id;
+		uint64_t sum;
+		memcpy(&id, in.data() + pos, sizeof(KeyType));
+		memcpy(&sum, in.data() + pos + sizeof(KeyType), sizeof(uint64_t));
+		fingerprint[local_index(id)] += sum;
+	}
+}
+
+/*
+	values of an earlier run on a graph that differs a little from this one, read from its binary results
+	(a file, directory or glob of the rank files) written with OUTPUT_ADJACENCY, by any number of ranks
+	the masters take the values of their records and pass them on to their mirrors, the vertices are active
+	where the graph changed: the new ones, which keep the values of init_fun, and those with other edges
+	programs also dividing by the degree of nbrs, as pagerank does, reach them through the scatter of these,
+	and programs whose values only decrease, as cc and sssp, start from valid values only when no edges were removed
+*/
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::warm_start(const char *path)
+{
+	double start = MPI_Wtime();
+	std::vector<std::string> shards;
+	if(!list_shards(path, shards))
+	{
+		fprintf(stderr, "Cannot read %s\n", path);
+		MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+	}
+	std::vector<uint64_t> fingerprint;
+	adjacency_fingerprints(fingerprint);
+
+	// every rank reads a share of the files and sends their records to the masters
+	const size_t head = sizeof(KeyType) + sizeof(uint64_t);
+	std::vector<std::vector<char> > out(size);
+	std::vector<char> in;
+	for (size_t s = rank; s < shards.size(); s += size)
+	{
+		std::vector<char> data(file_size(shards[s].c_str()));
+		FILE *fp = fopen(shards[s].c_str(), "rb");
+		if(!fp || fread(data.data(), 1, data.size(), fp) != data.size())
+		{
+			fprintf(stderr, "Cannot read %s\n", shards[s].c_str());
+			MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+		}
+		fclose(fp);
+		const char *ptr = data.data(), *end = data.data() + data.size();
+		while(ptr < end)
+		{
+			KeyType id;
+			ValueType value;
+			const char *next = NULL;
+			if((size_t)(end - ptr) >= head + (Serializer<ValueType>::fixed ? sizeof(ValueType) : 0))
+				next = Serializer<ValueType>::unpack(ptr + head, value);
+			if(!next || next > end)
+			{
+				fprintf(stderr, "Truncated record in %s\n", shards[s].c_str());
+				MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+			}
+			memcpy(&id, ptr, sizeof(KeyType));
+			std::vector<char> &buf = out[hash(id)];
+			buf.insert(buf.end(), ptr, next);
+			ptr = next;
+		}
+	}
+	exchange(out, in);
+
+	// vertices of the prior that are not in the graph any more are skipped
+	std::vector<char> seen(local_vertex.size(), 0), active(local_vertex.size(), 1);
+	unsigned long num_records = 0;
+	for (const char *ptr = in.data(); ptr < in.data() + in.size();)
+	{
+		KeyType id;
+		uint64_t sum;
+		ValueType value;
+		memcpy(&id, ptr, sizeof(KeyType));
+		memcpy(&sum, ptr + sizeof(KeyType), sizeof(uint64_t));
+		ptr = Serializer<ValueType>::unpack(ptr + head, value);
+		num_records++;
+		LocalId index;
+		if(!find_local(id, index))
+			continue;
+		local_vertex[index]->set_value(value);
+		seen[index] = 1;
+		active[index] = (sum != fingerprint[index]);
+	}
+
+	// the mirrors take the value and the activity of their masters, the high degree ones may be on every rank
+	for (auto &buf : out)
+		buf.clear();
+	size_t num_low = ltov_low_master.size() + ltov_low_mirror.size();
+	for (size_t i = 0; i < local_vertex.size(); ++i)
+	{
+		VertexType &v = *local_vertex[i];
+		if(hash(v.get_id()) != rank || !v.replicated)
+			continue;
+		auto append = [&](int target) {
+			std::vector<char> &buf = out[target];
+			size_t pos = buf.size();
+			buf.resize(pos + sizeof(KeyType) + 1 + Serializer<ValueType>::size(v.get_value()));
+			memcpy(buf.data() + pos, &v.get_id(), sizeof(KeyType));
+			buf[pos + sizeof(KeyType)] = active[i];
+			Serializer<ValueType>::pack(buf.data() + pos + sizeof(KeyType) + 1, v.get_value());
+		};
+		if(i >= num_low)
+		{
+			for (int target = 0; target < size; ++target)
+				if(target != rank)
+					append(target);
+		}
+		else
+		{
+			auto mirror_it = mirror.find(v.get_id());
+			if(mirror.end() != mirror_it)
+				for (int target : mirror_it->second)
+					append(target);
+		}
+	}
+	exchange(out, in);
+	for (const char *ptr = in.data(); ptr < in.data() + in.size();)
+	{
+		KeyType id;
+		ValueType value;
+		memcpy(&id, ptr, sizeof(KeyType));
+		char is_active = ptr[sizeof(KeyType)];
+		ptr = Serializer<ValueType>::unpack(ptr + sizeof(KeyType) + 1, value);
+		LocalId index;
+		if(!find_local(id, index))
+			continue;
+		local_vertex[index]->set_value(value);
+		active[index] = is_active;
+	}
+
+	low_active_master.clear();
+	low_active_mirror.clear();
+	high_active_master.clear();
+	high_active_mirror.clear();
+	unsigned long local[3] = {num_records, 0, 0}, global[3];
+	for (size_t i = 0; i < local_vertex.size(); ++i)
+	{
+		if(active[i])
+			set_active(i);
+		if(hash(local_vertex[i]->get_id()) != rank)
+			continue;
+		local[1] += !seen[i];
+		local[2] += active[i];
+	}
+	MPI_Reduce(local, global, 3, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
+	if(0 == rank)
+		printf("Warm start: %lu records, new vertices: %lu, active vertices: %lu, time: %lf (s)\n", global[0], global[1], global[2], MPI_Wtime() - start);
+}
+
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::write_values(const char *path, int output_type)
+{
+	double start = MPI_Wtime();
+	size_t num_low = ltov_low_master.size();
+	size_t num = num_low + ltov_high_master.size();
+	std::vector<uint64_t> fingerprint;
+	bool with_fingerprint = (OUTPUT_BINARY & output_type) && (OUTPUT_ADJACENCY & output_type);
+	if(with_fingerprint)
+		adjacency_fingerprints(fingerprint);
+
+	// every thread formats a contiguous range of masters into its own buffer
+	std::vector<std::vector<char> > bufs(COMP_THREADS);
+	#pragma omp parallel num_threads(COMP_THREADS)
+	{
+		int thread_id = omp_get_thread_num();
+		int num_threads = omp_get_num_threads();
+		std::vector<char> &buf = bufs[thread_id];
+		size_t len = 0;
+		for(size_t i = num * thread_id / num_threads; i < num * (thread_id + 1) / num_threads; ++i)
+		{
+			VertexType &v = *(i < num_low ? ltov_low_master[i] : ltov_high_master[i - num_low]);
+			if(OUTPUT_BINARY & output_type)
+			{
+				size_t head = sizeof(KeyType) + (with_fingerprint ? sizeof(uint64_t) : 0);
+				buf.resize(len + head + Serializer<ValueType>::size(v.get_value()));
+				memcpy(buf.data() + len, &v.get_id(), sizeof(KeyType));
+				if(with_fingerprint)
+					memcpy(buf.data() + len + sizeof(KeyType), &fingerprint[v.index], sizeof(uint64_t));
+				len = Serializer<ValueType>::pack(buf.data() + len + head, v.get_value()) - buf.data();
+				continue;
+			}
+			// the line is formatted again once the buffer is large enough for it
+			while(true)
+			{
+				size_t room = buf.size() - len;
+				int n = snprintf(buf.data() + len, room, "%llu ", (unsigned long long)v.get_id());
+				if((size_t)n < room)
+					n += TextValue<ValueType>::format(buf.data() + len + n, room - n, v.get_value());
+				if((size_t)n + 1 < room)
+				{
+					buf[len + n] = '\n';
+					len += n + 1;
+					break;
+				}
+				buf.resize(std::max(2 * buf.size(), len + n + 2));
+			}
+		}
+		buf.resize(len);
+	}
+
+	unsigned long long bytes = 0;
+	for(auto &buf : bufs)
+		bytes += buf.size();
+	if(OUTPUT_SINGLE & output_type)
+	{
+		// the ranks write at consecutive offsets, in chunks that fit the int counts of MPI
+		unsigned long long offset = 0;
+		MPI_Exscan(&bytes, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm->mpi_comm);
+		const size_t chunk = 1 << 30;
+		unsigned long long num_chunks = 0, max_chunks;
+		for(auto &buf : bufs)
+			num_chunks += (buf.size() + chunk - 1) / chunk;
+		MPI_Allreduce(&num_chunks, &max_chunks, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm->mpi_comm);
+		MPI_File file;
+		if(MPI_SUCCESS != MPI_File_open(comm->mpi_comm, path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file))
+		{
+			fprintf(stderr, "Cannot write %s\n", path);
+			MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+		}
+		MPI_File_set_size(file, 0);
+		size_t b = 0, pos = 0;
+		for(unsigned long long c = 0; c < max_chunks; ++c)
+		{
+			while(b < bufs.size() && pos == bufs[b].size())
+			{
+				b++;
+				pos = 0;
+			}
+			int count = b < bufs.size() ? std::min(chunk, bufs[b].size() - pos) : 0;
+			MPI_File_write_at_all(file, offset, count ? bufs[b].data() + pos : NULL, count, MPI_BYTE, MPI_STATUS_IGNORE);
+			offset += count;
+			pos += count;
+		}
+		MPI_File_close(&file);
+	}
+	else
+	{
+		std::string shard = std::string(path) + "." + std::to_string(rank);
+		FILE *fp = fopen(shard.c_str(), "w");
+		if(!fp)
+		{
+			fprintf(stderr, "Cannot write %s\n", shard.c_str());
+			MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+		}
+		for(auto &buf : bufs)
+			fwrite(buf.data(), 1, buf.size(), fp);
+		fclose(fp);
+	}
+
+	double time = MPI_Wtime() - start, max_time;
+	unsigned long long total_bytes;
+	MPI_Reduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, comm->mpi_comm);
+	MPI_Reduce(&bytes, &total_bytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm->mpi_comm);
+	if(0 == rank)
+		printf("Output: %s, %lf (MB), time: %lf (s)\n", path, total_bytes / 1048576.0, max_time);
+}
+
+/*
+	updates sent to the ranks of their dst with the edge messages, as in shuffle_edges
+	afterwards batch holds the updates of the current rank, which update_edges applies without sending them again
+*/
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::route_updates(std::vector<EdgeUpdate<KeyType> > &batch)
+{
+	if(1 == size)
+		return;
+
+	Sender<typename MesgBuf::EdgeMesg> *sender = new Sender<typename MesgBuf::EdgeMesg>(comm, EDGE);
+	size_t num_local = 0;
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		EdgeUpdate<KeyType> update = batch[i];
+		int target = hash(update.dst);
+		if(target == rank)
+		{
+			batch[num_local++] = update;
+			continue;
+		}
+		typename MesgBuf::EdgeMesg *bucket = sender->get_bucket(target);
+		// the id of a message is only used by the first of a block, the others tell insertions from deletions
+		bucket->id = update.insert;
+		bucket->src = update.src;
+		bucket->dst = update.dst;
+		bucket->weight = update.weight;
+	}
+	sender->flush();
+	delete sender;
+	MPI_Barrier(comm->mpi_comm);
+	while(comm->is_receiving());
+
+	batch.resize(num_local);
+	for(auto block_ptr : mesg_buf->get_edge_buf())
+	{
+		size_t buf_size = block_ptr->id;
+		for (size_t i = 1; i < buf_size + 1; i++)
+			batch.push_back(EdgeUpdate<KeyType>{block_ptr[i].src, block_ptr[i].dst, block_ptr[i].weight, 0 != block_ptr[i].id});
+		free(block_ptr);
+	}
+	(mesg_buf->get_edge_buf()).clear();
+}
+
+/*
+	edges of the batches of all ranks inserted or deleted (one of the copies, if an edge is there several times),
+	they are placed as when loading the graph, without moving any other edge:
+	updates go to the rank of their dst, where the edges of low degree vertices are kept and the replicas of their
+	srcs are created or retired, those of high degree vertices go on to the rank of their src
+	a low degree vertex whose in degree exceeds the threshold becomes high degree, as in load(), and its in edges
+	from other ranks move to the ranks of their srcs, high degree vertices stay so when edges are deleted
+	the local indexes are then renumbered, the kept vertices in their order and the new ones at the end,
+	so only the nbr lists of the changed vertices are built again
+	new vertices take their values from init_fun, the replicas of the endpoints of the updates take the values of their masters
+	and become active, so that programs recompute from the last values where the graph changed
+	(as for warm_start(), values that only decrease, as those of cc and sssp, stay valid only if no edges are deleted)
+*/
+template<class KeyType, class ValueType>
+unsigned long Graph<KeyType, ValueType>::update_edges(std::vector<EdgeUpdate<KeyType> > &batch, bool (*init_fun)(VertexType &v))
+{
+	double start = MPI_Wtime();
+	typedef UpdateMesg<KeyType> Mesg;
+	std::vector<std::vector<Mesg> > out(size);
+	std::vector<Mesg> in;
+	auto post = [&](int target, int step, KeyType src, KeyType dst, WeightType weight) {
+		out[target].push_back(Mesg{src, dst, weight, (uint8_t)step});
+	};
+	auto flush = [&]() {
+		exchange(out, in);
+		for(auto &mesgs : out)
+			mesgs.clear();
+	};
+
+	old_ids.resize(local_vertex.size());
+	for (size_t i = 0; i < local_vertex.size(); ++i)
+		old_ids[i] = local_vertex[i]->get_id();
+	std::unordered_set<KeyType> created; // new masters, which are initialized by init_fun
+	std::vector<KeyType> touched; // endpoints of the updates applied here
+	unsigned long local[3] = {0, 0, 0}, global[3]; // inserted, deleted, promoted
+
+	for(auto &update : batch)
+		post(hash(update.dst), update.insert ? UPDATE_INSERT : UPDATE_DELETE, update.src, update.dst, update.weight);
+	flush();
+
+	// at the rank of dst
+	std::vector<KeyType> grown;
+	for(auto &mesg : in)
+	{
+		KeyType src = mesg.src, dst = mesg.dst;
+		touched.push_back(src);
+		touched.push_back(dst);
+		if(high_degree_master.end() != high_degree_master.find(dst))
+		{
+			post(hash(src), UPDATE_INSERT == mesg.step ? HIGH_INSERT : HIGH_DELETE, src, dst, mesg.weight);
+			continue;
+		}
+		VertexType *dst_v = find_copy(dst);
+		if(!dst_v)
+		{
+			if(UPDATE_DELETE == mesg.step)
+				continue;
+			dst_v = &add_copy(low_degree_master, dst);
+			created.insert(dst);
+		}
+		if(src == dst)
+			continue;
+		VertexType *src_v = find_copy(src);
+		bool remote = (hash(src) != rank);
+		if(UPDATE_INSERT == mesg.step)
+		{
+			// a high degree src has a mirror on every rank
+			if(!src_v)
+			{
+				src_v = &add_copy(remote ? low_degree_mirror : low_degree_master, src);
+				if(!remote)
+					created.insert(src);
+			}
+			if(remote && !num_nbrs(*src_v))
+				post(hash(src), MIRROR_ADD, src, rank, 0);
+			add_nbr(*dst_v, src, mesg.weight, true);
+			add_nbr(*src_v, dst, mesg.weight, false);
+			grown.push_back(dst);
+			local[0]++;
+		}
+		else
+		{
+			if(!src_v || !remove_nbr(*dst_v, src, true))
+				continue;
+			remove_nbr(*src_v, dst, false);
+			if(remote && !num_nbrs(*src_v))
+				post(hash(src), MIRROR_REMOVE, src, rank, 0);
+			local[1]++;
+		}
+	}
+
+	// promote the low degree masters above the threshold, as load() does
+	std::sort(grown.begin(), grown.end());
+	grown.erase(std::unique(grown.begin(), grown.end()), grown.end());
+	for(auto id : grown)
+	{
+		auto ldma_it = low_degree_master.find(id);
+		if(low_degree_master.end() == ldma_it || ldma_it->second.get_in_nbr().size() <= threshold)
+			continue;
+		VertexType &v = move_copy(low_degree_master, high_degree_master, id);
+		mirror[id];
+		for (int i = 0; i < size; ++i)
+			if(i != rank)
+				post(i, PROMOTE, id, id, 0);
+		auto &in_nbrs = v.get_in_nbr();
+		size_t num_local = 0;
+		for (size_t j = 0; j < in_nbrs.size(); ++j)
+		{
+			KeyType src = in_nbrs[j];
+			WeightType weight = weighted ? v.get_in_weight()[j] : 1;
+			if(hash(src) == rank)
+			{
+				in_nbrs[num_local] = src;
+				if(weighted)
+					v.get_in_weight()[num_local] = weight;
+				num_local++;
+				continue;
+			}
+			post(hash(src), HIGH_MOVE, src, id, weight);
+			VertexType &src_v = *find_copy(src);
+			remove_nbr(src_v, id, false);
+			if(!num_nbrs(src_v))
+				post(hash(src), MIRROR_REMOVE, src, rank, 0);
+		}
+		in_nbrs.resize(num_local);
+		if(weighted)
+			v.get_in_weight().resize(num_local);
+		local[2]++;
+	}
+	flush();
+
+	// at the rank of src, once the promoted vertices have their mirrors
+	std::vector<Mesg> mirror_mesgs;
+	for(auto &mesg : in)
+	{
+		if(PROMOTE != mesg.step)
+			continue;
+		if(low_degree_mirror.end() != low_degree_mirror.find(mesg.src))
+			move_copy(low_degree_mirror, high_degree_mirror, mesg.src);
+		else if(high_degree_mirror.end() == high_degree_mirror.find(mesg.src))
+			add_copy(high_degree_mirror, mesg.src);
+	}
+	for(auto &mesg : in)
+	{
+		KeyType src = mesg.src, dst = mesg.dst;
+		if(MIRROR_ADD == mesg.step || MIRROR_REMOVE == mesg.step)
+			mirror_mesgs.push_back(mesg);
+		if(HIGH_INSERT != mesg.step && HIGH_DELETE != mesg.step && HIGH_MOVE != mesg.step)
+			continue;
+		if(src == dst)
+			continue;
+		VertexType *dst_v = find_copy(dst);
+		VertexType *src_v = find_copy(src);
+		bool remote = (hash(dst) != rank);
+		if(HIGH_DELETE == mesg.step)
+		{
+			if(!dst_v || !src_v || !remove_nbr(*dst_v, src, true))
+				continue;
+			remove_nbr(*src_v, dst, false);
+			if(remote && !num_nbrs(*dst_v))
+				post(hash(dst), MIRROR_REMOVE, dst, rank, 0);
+			local[1]++;
+			continue;
+		}
+		if(!src_v)
+		{
+			src_v = &add_copy(low_degree_master, src);
+			created.insert(src);
+		}
+		if(remote && !num_nbrs(*dst_v))
+			post(hash(dst), MIRROR_ADD, dst, rank, 0);
+		add_nbr(*dst_v, src, mesg.weight, true);
+		add_nbr(*src_v, dst, mesg.weight, false);
+		if(HIGH_INSERT == mesg.step)
+			local[0]++;
+	}
+	flush();
+
+	// at the masters, whose mirror sets follow the replicas with edges
+	mirror_mesgs.insert(mirror_mesgs.end(), in.begin(), in.end());
+	for(auto &mesg : mirror_mesgs)
+	{
+		if(!find_copy(mesg.src))
+		{
+			add_copy(low_degree_master, mesg.src);
+			created.insert(mesg.src);
+		}
+		auto &mirror_set = mirror[mesg.src];
+		if(MIRROR_ADD == mesg.step)
+			mirror_set.insert(mesg.dst);
+		else
+			mirror_set.erase(mesg.dst);
+		// high degree masters keep their entry, as after load()
+		if(mirror_set.empty() && low_degree_master.end() != low_degree_master.find(mesg.src))
+			mirror.erase(mesg.src);
+	}
+
+	// the local indexes and the state arrays of the new vertices, before their values are set
+	rebuild();
+
+	// the masters of the endpoints initialize the new vertices and pass their values on to their replicas
+	std::sort(touched.begin(), touched.end());
+	touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+	for(auto id : touched)
+		post(hash(id), ACTIVATE, id, id, 0);
+	flush();
+	std::vector<KeyType> active_ids;
+	std::vector<std::vector<char> > value_out(size);
+	std::vector<char> value_in;
+	for(auto &mesg : in)
+	{
+		VertexType *v = find_copy(mesg.src);
+		if(!v)
+			continue;
+		if(created.count(mesg.src))
+			init_fun(*v);
+		active_ids.push_back(mesg.src);
+		auto append = [&](int target) {
+			std::vector<char> &buf = value_out[target];
+			size_t pos = buf.size();
+			buf.resize(pos + sizeof(KeyType) + Serializer<ValueType>::size(v->get_value()));
+			memcpy(buf.data() + pos, &v->get_id(), sizeof(KeyType));
+			Serializer<ValueType>::pack(buf.data() + pos + sizeof(KeyType), v->get_value());
+		};
+		if(high_degree_master.end() != high_degree_master.find(mesg.src))
+		{
+			for (int target = 0; target < size; ++target)
+				if(target != rank)
+					append(target);
+			continue;
+		}
+		auto mirror_it = mirror.find(mesg.src);
+		if(mirror.end() != mirror_it)
+			for (int target : mirror_it->second)
+				append(target);
+	}
+	exchange(value_out, value_in);
+	for (const char *ptr = value_in.data(); ptr < value_in.data() + value_in.size();)
+	{
+		KeyType id;
+		ValueType value;
+		memcpy(&id, ptr, sizeof(KeyType));
+		ptr = Serializer<ValueType>::unpack(ptr + sizeof(KeyType), value);
+		VertexType *v = find_copy(id);
+		if(!v)
+			continue;
+		v->set_value(value);
+		active_ids.push_back(id);
+	}
+
+	for(auto id : active_ids)
+	{
+		LocalId index;
+		if(find_local(id, index))
+			set_active(index);
+	}
+
+	MPI_Allreduce(local, global, 3, MPI_UNSIGNED_LONG, MPI_SUM, comm->mpi_comm);
+	num_edges += global[0] - global[1];
+	unsigned long num_active = 0, total_active;
+	for(auto id : active_ids)
+		num_active += (hash(id) == rank);
+	MPI_Reduce(&num_active, &total_active, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm->mpi_comm);
+	if(0 == rank)
+		printf("Update: inserted: %lu, deleted: %lu, promoted: %lu, active vertices: %lu, edges: %lu, time: %lf (s)\n",
+			global[0], global[1], global[2], total_active, num_edges, MPI_Wtime() - start);
+	return global[1];
+}
+
+// the local vertex of id, master or mirror, NULL if it is not on this rank
+template<class KeyType, class ValueType>
+inline Vertex<KeyType, ValueType> *Graph<KeyType, ValueType>::find_copy(KeyType id)
+{
+	VertexContainer *containers[2] = {&low_degree_master, &high_degree_master};
+	if(hash(id) != rank)
+	{
+		containers[0] = &low_degree_mirror;
+		containers[1] = &high_degree_mirror;
+	}
+	for(auto vertex_container : containers)
+	{
+		auto it = vertex_container->find(id);
+		if(vertex_container->end() != it)
+			return &it->second;
+	}
+	return NULL;
+}
+
+template<class KeyType, class ValueType>
+inline Vertex<KeyType, ValueType> &Graph<KeyType, ValueType>::add_copy(VertexContainer &vertex_container, KeyType id)
+{
+	return vertex_container.emplace(std::piecewise_construct, std::forward_as_tuple(id), std::forward_as_tuple(id)).first->second;
+}
+
+// the vertex takes its nbr lists along, as ids
+template<class KeyType, class ValueType>
+inline Vertex<KeyType, ValueType> &Graph<KeyType, ValueType>::move_copy(VertexContainer &from, VertexContainer &to, KeyType id)
+{
+	auto it = from.find(id);
+	expand_nbrs(it->second);
+	VertexType &v = to.emplace(id, it->second).first->second;
+	from.erase(it);
+	return v;
+}
+
+/*
+	nbr lists of local indexes back to ids, with their weights, before they are changed
+*/
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::expand_nbrs(VertexType &v)
+{
+	if(v.has_nbr_vec())
+		return;
+	v.alloc_nbr_vec();
+	const WeightType *weight = weighted ? edge_weights.data() + v.edge_offset : NULL;
+	auto expand = [&](std::vector<LocalId> &nbrs_i, CompressedList &nbrs_c, bool is_in)
+	{
+		auto &ids = is_in ? v.get_in_nbr() : v.get_out_nbr();
+		auto add = [&](uint32_t index)
+		{
+			ids.push_back(old_ids[index]);
+			if(weight)
+				(is_in ? v.get_in_weight() : v.get_out_weight()).push_back(*weight++);
+		};
+		if(compressed)
+			nbrs_c.for_each(add);
+		else
+			for(auto index : nbrs_i)
+				add(index);
+		std::vector<LocalId>().swap(nbrs_i);
+		nbrs_c = CompressedList();
+	};
+	expand(v.in_nbrs_i, v.in_nbrs_c, true);
+	expand(v.out_nbrs_i, v.out_nbrs_c, false);
+}
+
+template<class KeyType, class ValueType>
+inline void Graph<KeyType, ValueType>::add_nbr(VertexType &v, KeyType nbr, WeightType weight, bool is_in)
+{
+	expand_nbrs(v);
+	(is_in ? v.get_in_nbr() : v.get_out_nbr()).push_back(nbr);
+	if(weighted)
+		(is_in ? v.get_in_weight() : v.get_out_weight()).push_back(weight);
+}
+
+// the order of the nbrs is restored by init_nbr_ptr
+template<class KeyType, class ValueType>
+inline bool Graph<KeyType, ValueType>::remove_nbr(VertexType &v, KeyType nbr, bool is_in)
+{
+	expand_nbrs(v);
+	auto &nbrs = is_in ? v.get_in_nbr() : v.get_out_nbr();
+	auto it = std::find(nbrs.begin(), nbrs.end(), nbr);
+	if(nbrs.end() == it)
+		return false;
+	size_t pos = it - nbrs.begin();
+	nbrs[pos] = nbrs.back();
+	nbrs.pop_back();
+	if(weighted)
+	{
+		auto &weights = is_in ? v.get_in_weight() : v.get_out_weight();
+		weights[pos] = weights.back();
+		weights.pop_back();
+	}
+	return true;
+}
+
+template<class KeyType, class ValueType>
+inline size_t Graph<KeyType, ValueType>::num_nbrs(VertexType &v)
+{
+	if(v.has_nbr_vec())
+		return v.get_in_nbr().size() + v.get_out_nbr().size();
+	return v.in_nbrs_size() + v.out_nbrs_size();
+}
+
+/*
+	local indexes again after update_edges, the kept vertices of each type in their order followed by the new ones,
+	low degree mirrors left without edges are retired
+	the changed vertices build their nbr lists from their ids, the others translate their local indexes
+*/
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::rebuild()
+{
+	for(auto it = low_degree_mirror.begin(); it != low_degree_mirror.end();)
+	{
+		if(it->second.has_nbr_vec() && !num_nbrs(it->second))
+		{
+			it->second.clear_nbr_vec();
+			it = low_degree_mirror.erase(it);
+		}
+		else
+			++it;
+	}
+
+	VertexContainer *containers[4] = {&low_degree_master, &low_degree_mirror, &high_degree_master, &high_degree_mirror};
+	std::unordered_map<KeyType, LocalId> *gtols[4] = {&gtol_low_master, &gtol_low_mirror, &gtol_high_master, &gtol_high_mirror};
+	std::unordered_map<LocalId, KeyType> *ltogs[4] = {&ltog_low_master, &ltog_low_mirror, &ltog_high_master, &ltog_high_mirror};
+	std::vector<VertexType *> *ltovs[4] = {&ltov_low_master, &ltov_low_mirror, &ltov_high_master, &ltov_high_mirror};
+	std::vector<KeyType> order[4];
+	size_t first = 0;
+	for (int c = 0; c < 4; ++c)
+	{
+		size_t num = ltovs[c]->size();
+		for (size_t i = first; i < first + num; ++i)
+			if(containers[c]->end() != containers[c]->find(old_ids[i]))
+				order[c].push_back(old_ids[i]);
+		for(auto &pair : *containers[c])
+			if(gtols[c]->end() == gtols[c]->find(pair.first))
+				order[c].push_back(pair.first);
+		first += num;
+		gtols[c]->clear();
+		ltogs[c]->clear();
+		ltovs[c]->clear();
+	}
+	local_vertex.clear();
+	std::vector<ValueType> old_values;
+	old_values.swap(vertex_state.value);
+	init_map(order);
+
+	// old local index -> new one, the same if no vertex came or left, the kept vertices take their values along
+	std::vector<LocalId> remap(old_ids.size(), std::numeric_limits<LocalId>::max());
+	bool moved = (old_ids.size() != local_vertex.size());
+	for (size_t i = 0; i < old_ids.size(); ++i)
+	{
+		LocalId index;
+		if(find_local(old_ids[i], index))
+		{
+			remap[i] = index;
+			vertex_state.value[index] = old_values[i];
+		}
+		moved |= (remap[i] != i);
+	}
+
+	if(weighted)
+	{
+		std::vector<WeightType> weights;
+		size_t num_local_edges = 0;
+		for(auto v : local_vertex)
+		{
+			size_t offset = v->edge_offset;
+			v->edge_offset = num_local_edges;
+			num_local_edges += num_nbrs(*v);
+			if(!v->has_nbr_vec())
+				weights.insert(weights.end(), edge_weights.begin() + offset, edge_weights.begin() + offset + num_nbrs(*v));
+			else
+				weights.resize(num_local_edges);
+		}
+		edge_weights.swap(weights);
+	}
+
+	#pragma omp parallel for num_threads(COMP_THREADS)
+	for (size_t i = 0; i < local_vertex.size(); ++i)
+	{
+		VertexType &v = *local_vertex[i];
+		if(v.has_nbr_vec())
+			init_nbr_ptr(v);
+		else if(moved)
+			remap_nbrs(v, remap);
+	}
+	std::vector<KeyType>().swap(old_ids);
+}
+
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::remap_nbrs(VertexType &v, std::vector<LocalId> &remap)
+{
+	WeightType *weight = weighted ? edge_weights.data() + v.edge_offset : NULL;
+	auto translate = [&](std::vector<LocalId> &nbrs_i, CompressedList &nbrs_c, WeightType *weight)
+	{
+		if(compressed)
+			nbrs_c.for_each([&](uint32_t index) {nbrs_i.push_back(remap[index]);});
+		else
+			for(auto &index : nbrs_i)
+				index = remap[index];
+		// a promoted vertex moves to another type
+		if((compressed || REORDER_NONE != reorder_type) && !std::is_sorted(nbrs_i.begin(), nbrs_i.end()))
+			sort_nbrs(nbrs_i, weight);
+		if(compressed)
+		{
+			nbrs_c.encode(nbrs_i);
+			std::vector<LocalId>().swap(nbrs_i);
+		}
+	};
+	size_t num_in = v.in_nbrs_size();
+	translate(v.in_nbrs_i, v.in_nbrs_c, weight);
+	translate(v.out_nbrs_i, v.out_nbrs_c, weight ? weight + num_in : NULL);
+}
+
+template<class KeyType, class ValueType>
+void Graph<KeyType, ValueType>::init_nbr_ptr(VertexType &v)
+{
+	// move the weights into the edge value array, where they are permuted along with the nbrs
+	WeightType *in_weight = NULL, *out_weight = NULL;
+	if(weighted)
+	{
+		in_weight = edge_weights.data() + v.edge_offset;
+		out_weight = in_weight + v.get_in_nbr().size();
+		std::copy(v.get_in_weight().begin(), v.get_in_weight().end(), in_weight);
+		std::copy(v.get_out_weight().begin(), v.get_out_weight().end(), out_weight);
+	}
+
+	v.in_nbrs_i.reserve(v.get_in_nbr().size());
+	for(auto in_nbr : v.get_in_nbr())
+		v.in_nbrs_i.push_back(local_index(in_nbr));
+	v.out_nbrs_i.reserve(v.get_out_nbr().size());
+	for(auto out_nbr : v.get_out_nbr())
+		v.out_nbrs_i.push_back(local_index(out_nbr));
+	v.clear_nbr_vec(); // free the nbr vector which would be unused
+
+	// visit neighbors in the order of the local ids, required by the delta encoding
+	if(compressed || REORDER_NONE != reorder_type)
+	{
+		sort_nbrs(v.in_nbrs_i, in_weight);
+		sort_nbrs(v.out_nbrs_i, out_weight);
+	}
+
+	if(compressed)
+	{
+		v.in_nbrs_c.encode(v.in_nbrs_i);
+		v.out_nbrs_c.encode(v.out_nbrs_i);
+		std::vector<LocalId>().swap(v.in_nbrs_i);
+		std::vector<LocalId>().swap(v.out_nbrs_i);
+	}
+}
+
+template<class KeyType, class ValueType>
+template<class NbrType>
+inline void Graph<KeyType, ValueType>::sort_nbrs(std::vector<NbrType> &nbrs, WeightType *weights)
+{
+	if(!weights)
+	{
+		std::sort(nbrs.begin(), nbrs.end());
+		return;
+	}
+	std::vector<std::pair<NbrType, WeightType> > pairs(nbrs.size());
+	for (size_t i = 0; i < nbrs.size(); ++i)
+		pairs[i] = std::make_pair(nbrs[i], weights[i]);
+	std::sort(pairs.begin(), pairs.end());
+	for (size_t i = 0; i < nbrs.size(); ++i)
+	{
+		nbrs[i] = pairs[i].first;
+		weights[i] = pairs[i].second;
+	}
+}
+
+template<class KeyType, class ValueType>
+inline LocalId Graph<KeyType, ValueType>::local_index(KeyType id)
+{
+	LocalId index;
+	if(find_local(id, index))
+		return index;
+	fprintf(stderr, "Rank: %d, vertex %llu not found\n", rank, (unsigned long long)id);
+	MPI_Abort(comm->mpi_comm, EXIT_FAILURE);
+	return 0;
+}
+
+// like local_index, false if the vertex is not on this rank
+template<class KeyType, class ValueType>
+inline bool Graph<KeyType, ValueType>::find_local(KeyType id, LocalId &index)
+{
+	if(hash(id) == rank)
+	{
+		auto it = gtol_low_master.find(id);
+		if(gtol_low_master.end() != it)
+		{
+			index = it->second;
+			return true;
+		}
+		it = gtol_high_master.find(id);
+		if(gtol_high_master.end() != it)
+		{
+			index = ltov_low_master.size() + ltov_low_mirror.size() + it->second;
+			return true;
+		}
+	}
+	else
+	{
+		auto it = gtol_low_mirror.find(id);
+		if(gtol_low_mirror.end() != it)
+		{
+			index = ltov_low_master.size() + it->second;
+			return true;
+		}
+		it = gtol_high_mirror.find(id);
+		if(gtol_high_mirror.end() != it)
+		{
+			index = ltov_low_master.size() + ltov_low_mirror.size() + ltov_high_master.size() + it->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+	f(nbr vertex pointer, edge weight), the weight is 1 on unweighted graphs
+*/
+template<class KeyType, class ValueType>
+template<class Func>
+inline void Graph<KeyType, ValueType>::for_each_in_nbr(VertexType &v, Func f)
+{
+	const WeightType *weight = weighted ? edge_weights.data() + v.edge_offset : NULL;
+	for_each_nbr(v.in_nbrs_i, v.in_nbrs_c, weight, f);
+}
+
+template<class KeyType, class ValueType>
+template<class Func>
+inline void Graph<KeyType, ValueType>::for_each_out_nbr(VertexType &v, Func f)
+{
+	const WeightType *weight = weighted ? edge_weights.data() + v.edge_offset + v.in_nbrs_size() : NULL;
+	for_each_nbr(v.out_nbrs_i, v.out_nbrs_c, weight, f);
+}
+
+template<class KeyType, class ValueType>
+template<class Func>
+inline void Graph<KeyType, ValueType>::for_each_nbr(std::vector<LocalId> &nbrs_i, CompressedList &nbrs_c, const WeightType *weight, Func f)
+{
+	if(compressed)
+	{
+		if(weight)
+			nbrs_c.for_each([&](uint32_t index) {f(local_vertex[index], *weight++);});
+		else
+			nbrs_c.for_each([&](uint32_t index) {f(local_vertex[index], (WeightType)1);});
+	}
+	else
+	{
+		if(weight)
+			for(auto index : nbrs_i)
+				f(local_vertex[index], *weight++);
+		else
+			for(auto index : nbrs_i)
+				f(local_vertex[index], (WeightType)1);
+	}
+}
+
+/*
+	sum of array[local index] over the nbrs, for programs with a dense gather
+*/
+template<class KeyType, class ValueType>
+inline ValueType Graph<KeyType, ValueType>::sum_in_nbr(VertexType &v, const ValueType *array)
+{
+	return sum_nbr(v.in_nbrs_i, v.in_nbrs_c, array);
+}
+
+template<class KeyType, class ValueType>
+inline ValueType Graph<KeyType, ValueType>::sum_out_nbr(VertexType &v, const ValueType *array)
+{
+	return sum_nbr(v.out_nbrs_i, v.out_nbrs_c, array);
+}
+
+template<class KeyType, class ValueType>
+inline ValueType Graph<KeyType, ValueType>::sum_nbr(std::vector<LocalId> &nbrs_i, CompressedList &nbrs_c, const ValueType *array)
+{
+	if(compressed)
+	{
+		ValueType sum = ValueType();
+		nbrs_c.for_each([&](uint32_t index) {sum = sum + array[index];});
+		return sum;
+	}
+	return gather_sum(array, nbrs_i.data(), nbrs_i.size());
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -2,73 +2,7 @@
 #include "controller.hpp"
 #include "graph.hpp"
 #include "engine.hpp"
-#include "vertexprogram.hpp"
-
-template<class KeyType, class ValueType>
-class KCore: public VertexProgram<KeyType, ValueType>
-{
-private:
-	const ValueType delta = 0;
-	typedef Vertex<KeyType, ValueType> VertexType;	
-public:
-	static int K;
-	KCore() {this->iterations = 50; this->acc_init = 0;}
-	~KCore() {}
-	
-	EDGE_DIRECTION gather_edge() {return ALL_EDGES;}
-	EDGE_DIRECTION gather_edge(VertexType &v) {return ALL_EDGES;}
-
-	EDGE_DIRECTION scatter_edge() {return ALL_EDGES;}
-	EDGE_DIRECTION scatter_edge(VertexType &v)
-	{
-		// if deleted then scatter
-		if(v.change)
-			return ALL_EDGES;
-		else
-			return NO_EDGES;
-	}
-
-	ValueType gather(VertexType &v, VertexType &nbr)
-	{
-		if(nbr.get_value() >= K)
-			return 1;
-		else
-			return 0;
-	}
-
-	ValueType op(ValueType x, ValueType y)
-	{
-		return x + y;
-	}
-
-	void apply(VertexType &v, ValueType total)
-	{
-		// set value to the nubmer of nbrs not deleted
-		v.set_value(total);
-		v.change = v.get_value() < K ? 1 : 0;
-
-		//log("ID: %d, Value: %d, change: %d\n", v.get_id(), v.get_value(), v.change);
-	}
-
-	bool scatter(VertexType &v, VertexType &nbr)
-	{
-		// printf("nbr: %d\n", nbr.get_value());
-		// if nbr not deleted then activate it
-		if(nbr.get_value() >= K)
-			return true;
-		else
-			return false;
-	}
-
-	static bool init_vertex(VertexType &v)
-	{
-		v.set_value(K);
-		return true;
-	}
-};
-
-template<class KeyType, class ValueType>
-int KCore<KeyType, ValueType>::K = 0;
+#include "kcore.hpp"
 
 template<class KeyType, class ValueType>
 ValueType op(ValueType x, ValueType y)
@@ -78,7 +12,7 @@ ValueType op(ValueType x, ValueType y)
 
 template<class KeyType>
 void format_print(KeyType id, FILE* fp) {
-	fprintf(fp, "  %d [front=white, color=red]\n", id);
+	fprintf(fp, "  %lu [front=white, color=red]\n", (unsigned long)id);
 }
 
 template<class KeyType, class ValueType>
@@ -107,10 +41,19 @@ int main(int argc, char *argv[])
 	int opt;
 	char *file_path = NULL;
 	size_t threshold = 1000;
+	int reorder_type = REORDER_NONE;
+	bool compressed = false;
+	bool weighted = false;
+	int id_bits = 32;
+	char *output = NULL;
+	int output_type = OUTPUT_TEXT;
+	char *checkpoint = NULL;
+	int period = 10;
+	bool restart = false;
 
 	char *outfile = NULL;
 
-    while ((opt = getopt(argc, argv, "g:t:k:p:")) != -1) {
+    while ((opt = getopt(argc, argv, "g:t:k:p:r:cwi:o:O:C:P:R")) != -1) {
         switch (opt) {
         case 'g':
             file_path = optarg;
@@ -118,35 +61,66 @@ int main(int argc, char *argv[])
         case 't':
             threshold = (size_t)atoi(optarg);
             break;
+        case 'r':
+            reorder_type = atoi(optarg);
+            break;
+        case 'c':
+            compressed = true;
+            break;
+        case 'w':
+            weighted = true;
+            break;
+        case 'i':
+            id_bits = atoi(optarg);
+            break;
         case 'k':
-        	KCore<int, int>::K = atoi(optarg);
+        	KCore<VertexId, int>::K = atoi(optarg);
         	break;
         case 'p':
         	outfile = optarg;
         	break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'O':
+            output_type = atoi(optarg);
+            break;
+        case 'C':
+            checkpoint = optarg;
+            break;
+        case 'P':
+            period = atoi(optarg);
+            break;
+        case 'R':
+            restart = true;
+            break;
         default:
-            fprintf(stderr, "Usage: %s [-g graph] [-t threshold] [-k K]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-k K] [-r reorder] [-c] [-w] [-i id bits] [-o output] [-O output type] [-C checkpoint] [-P checkpoint period] [-R]\n", argv[0]);
             exit(EXIT_FAILURE);
         }
     }
 
-	if (file_path == NULL || KCore<int, int>::K == -1) {
-		fprintf(stderr, "Usage: %s [-g graph] [-t threshold] [-k K]\n", argv[0]);
+	if (file_path == NULL || KCore<VertexId, int>::K == -1) {
+		fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-k K] [-r reorder] [-c] [-w] [-i id bits] [-o output] [-O output type] [-C checkpoint] [-P checkpoint period] [-R]\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
-	Controller<int, int> controller;
+	Controller<VertexId, int> controller;
 
-	KCore<int, int> kcore;
+	KCore<VertexId, int> kcore;
 	
-	Graph<int, int> graph(&controller, file_path, threshold, 1);
-	graph.transform_vertices(KCore<int, int>::init_vertex);
+	Graph<VertexId, int> graph(&controller, file_path, threshold, 1, reorder_type, compressed, weighted, id_bits);
+	graph.transform_vertices(KCore<VertexId, int>::init_vertex);
 	
-	Engine<int, int> engine(&controller, &graph, &kcore);
+	Engine<VertexId, int> engine(&controller, &graph, &kcore);
+	if(checkpoint)
+		engine.set_checkpoint(checkpoint, period, restart);
 	engine.run();
+	if(output)
+		graph.write_values(output, output_type);
 
 	if (outfile != NULL) {
-		show_core<int, int>(graph, KCore<int, int>::K, outfile);
+		show_core<VertexId, int>(graph, KCore<VertexId, int>::K, outfile);
 	}
 	return 0;
 }
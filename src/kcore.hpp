@@ -0,0 +1,72 @@
+#ifndef KCORE
+#define KCORE
+
+#include "vertexprogram.hpp"
+
+template<class KeyType, class ValueType>
+class KCore: public VertexProgram<KeyType, ValueType>
+{
+private:
+	const ValueType delta = 0;
+	typedef Vertex<KeyType, ValueType> VertexType;	
+public:
+	static int K;
+	KCore() {this->iterations = 50; this->acc_init = 0;}
+	~KCore() {}
+	
+	EDGE_DIRECTION gather_edge() {return ALL_EDGES;}
+	EDGE_DIRECTION gather_edge(VertexType &v) {return ALL_EDGES;}
+
+	EDGE_DIRECTION scatter_edge() {return ALL_EDGES;}
+	EDGE_DIRECTION scatter_edge(VertexType &v)
+	{
+		// if deleted then scatter
+		if(v.get_change())
+			return ALL_EDGES;
+		else
+			return NO_EDGES;
+	}
+
+	ValueType gather(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		if(nbr.get_value() >= K)
+			return 1;
+		else
+			return 0;
+	}
+
+	ValueType op(ValueType x, ValueType y)
+	{
+		return x + y;
+	}
+
+	void apply(VertexType &v, ValueType total)
+	{
+		// set value to the nubmer of nbrs not deleted
+		v.set_value(total);
+		v.set_change(v.get_value() < K ? 1 : 0);
+
+		//log("ID: %d, Value: %d, change: %d\n", v.get_id(), v.get_value(), v.get_change());
+	}
+
+	bool scatter(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		// printf("nbr: %d\n", nbr.get_value());
+		// if nbr not deleted then activate it
+		if(nbr.get_value() >= K)
+			return true;
+		else
+			return false;
+	}
+
+	static bool init_vertex(VertexType &v)
+	{
+		v.set_value(K);
+		return true;
+	}
+};
+
+template<class KeyType, class ValueType>
+int KCore<KeyType, ValueType>::K = 0;
+
+#endif
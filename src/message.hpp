@@ -9,9 +9,13 @@
 #include "log.h"
 #include "vertex.hpp"
 #include "vertexprogram.hpp"
+#include "serialize.hpp"
+#include <mutex>
 
 template<class KeyType, class ValueType>
 class Graph;
+template<class MesgType>
+class Sender;
 
 typedef enum
 {
@@ -20,9 +24,41 @@ typedef enum
 	SYNC_MASTER_HIGH = 2,
 	SYNC_MIRROR_LOW = 3,
 	SYNC_MIRROR_HIGH = 4,
-	ACT = 5
+	ACT = 5,
+	ASYNC_MASTER = 6,
+	ASYNC_MIRROR = 7,
+	SSP_TAG = 8
 } TAG;
 
+/*
+	tags of the stale synchronous mode, see SspEngine, from SSP_TAG on
+	they carry the kind of the message, the iteration stamp modulo SSP_WINDOW and the source rank
+*/
+typedef enum
+{
+	SSP_CLOCK = 0, // number of iterations the source has finished
+	SSP_PARTIAL = 1, // gathered values of mirrors to their masters
+	SSP_VALUE = 2, // applied values of masters to their mirrors
+	SSP_KINDS = 3
+} SSP_KIND;
+const int SSP_WINDOW = 32;
+
+inline int ssp_tag(int kind, int stamp, int source, int size)
+{
+	return SSP_TAG + ((stamp % SSP_WINDOW) * SSP_KINDS + kind) * size + source;
+}
+
+/*
+	handler of an engine that processes some messages itself as they arrive, see AsyncEngine
+	process_mesg returns false for the messages left to the MessageBuffer
+*/
+class MesgHandler
+{
+public:
+	virtual ~MesgHandler() {}
+	virtual bool process_mesg(int tag, void *buf) = 0;
+};
+
 // template<class KeyType, class ValueType>
 // extern inline ValueType op(ValueType x, ValueType y);
 
@@ -30,21 +66,84 @@ template<class KeyType, class ValueType>
 class MessageBuffer
 {
 public:
-	struct EdgeMesg
+	struct __attribute__((packed)) EdgeMesg
 	{
 		//char mark;
 		KeyType id;
 		KeyType src;
 		KeyType dst;
 		//ValueType src_value;
-		ValueType dst_value;
-		//ValueType edge_value;
+		WeightType weight;
 	};
-	struct SyncMesg
+	/*
+		sync messages of the values of vertices, sent as WireType, the type the vertex program declares for its messages
+		(see VertexProgram::WireType), values are accumulated and stored in ValueType, and only rounded when sent
+		values that are not trivially copyable are sent through their Serializer
+	*/
+	template<class WireType>
+	struct Sync
 	{
-		//char mark;
-		KeyType id;
-		ValueType value;
+		// a value of variable size is packed right after its message, which holds its length in bytes instead
+		typedef typename std::conditional<Serializer<WireType>::fixed, WireType, uint32_t>::type Value;
+		struct __attribute__((packed)) Mesg
+		{
+			KeyType id;
+			Value value;
+		};
+
+		static inline void put(Sender<Mesg> *sender, int target, KeyType id, const WireType &value)
+		{
+			put(sender, target, id, value, std::integral_constant<bool, Serializer<WireType>::fixed>());
+		}
+		// f(id, value) for every sync mesg of a received block
+		template<class Func>
+		static inline void for_each(void *buf, Func f)
+		{
+			for_each(buf, f, std::integral_constant<bool, Serializer<WireType>::fixed>());
+		}
+
+	private:
+		static inline void put(Sender<Mesg> *sender, int target, KeyType id, const WireType &value, std::true_type fixed)
+		{
+			Mesg *bucket = sender->get_bucket(target);
+			bucket->id = id;
+			bucket->value = value;
+		}
+		static inline void put(Sender<Mesg> *sender, int target, KeyType id, const WireType &value, std::false_type fixed)
+		{
+			uint32_t bytes = Serializer<WireType>::size(value);
+			char *ptr = sender->get_bytes(target, sizeof(Mesg) + bytes);
+			Mesg mesg = {id, bytes};
+			memcpy(ptr, &mesg, sizeof(Mesg));
+			Serializer<WireType>::pack(ptr + sizeof(Mesg), value);
+		}
+		template<class Func>
+		static inline void for_each(void *buf, Func f, std::true_type fixed)
+		{
+			size_t size = ((Mesg *)buf)->id;
+			for (size_t i = 1; i < size + 1; ++i)
+			{
+				Mesg *mesg = (Mesg *)buf + i;
+				WireType value = mesg->value;
+				f(mesg->id, value);
+			}
+		}
+		template<class Func>
+		static inline void for_each(void *buf, Func f, std::false_type fixed)
+		{
+			size_t size = ((Mesg *)buf)->id;
+			const char *ptr = (const char *)buf + sizeof(Mesg);
+			WireType value;
+			for (size_t i = 0; i < size; ++i)
+			{
+				Mesg mesg;
+				memcpy(&mesg, ptr, sizeof(Mesg));
+				ptr += sizeof(Mesg);
+				Serializer<WireType>::unpack(ptr, value);
+				ptr += mesg.value;
+				f(mesg.id, value);
+			}
+		}
 	};
 	struct ActMesg
 	{
@@ -58,18 +157,29 @@ public:
 	// storing value from mirrors, indexed by local id
 	ValueType *sync_buf_low;
 	ValueType *sync_buf_high; 
+	MesgHandler *handler;
 	void init(Graph<KeyType, ValueType> *graph, VertexProgType *v_prog)
 	{
 		this->graph = graph;
 		this->v_prog = v_prog;
-		sync_buf_low = (ValueType *)malloc(sizeof(ValueType) * graph->low_degree_master.size());
-		sync_buf_high = (ValueType *)malloc(sizeof(ValueType) * graph->high_degree_master.size());
+		// again for every engine run on the graph
+		delete []sync_buf_low;
+		delete []sync_buf_high;
+		sync_buf_low = new ValueType[graph->low_degree_master.size()];
+		sync_buf_high = new ValueType[graph->high_degree_master.size()];
 	}
 	
-	MessageBuffer(int rank):rank(rank) {}
-	~MessageBuffer() {free(sync_buf_low); free(sync_buf_high);}
+	MessageBuffer(int rank):sync_buf_low(NULL), sync_buf_high(NULL), handler(NULL), rank(rank) {}
+	~MessageBuffer() {delete []sync_buf_low; delete []sync_buf_high;}
 
 	inline void process_mesg(int tag, void *buf);
+
+	// combine value into an accumulator that other threads update concurrently, false if it is known unchanged
+	// values wider than a compare and swap take the striped locks
+	inline bool accumulate(ValueType *acc, const ValueType &value)
+	{
+		return accumulate(acc, value, std::integral_constant<bool, std::is_trivially_copyable<ValueType>::value && sizeof(ValueType) <= sizeof(uint64_t)>());
+	}
 	
 	inline EDGE_BUF & get_edge_buf() {return edge_buf;}
 
@@ -87,14 +197,42 @@ private:
 	
 	EDGE_BUF edge_buf;
 
-	std::pair<KeyType, SyncMesg*> sync_local_buf; // mesg generated by local master
+	// locks of the accumulators for values that cannot be compared and swapped
+	static const int SYNC_LOCKS = 64;
+	std::mutex sync_lock[SYNC_LOCKS];
+
+	inline bool accumulate(ValueType *acc, const ValueType &value, std::true_type lock_free);
+	inline bool accumulate(ValueType *acc, const ValueType &value, std::false_type lock_free);
 };
 
+template<class KeyType, class ValueType>
+inline bool MessageBuffer<KeyType, ValueType>::accumulate(ValueType *acc, const ValueType &value, std::true_type lock_free)
+{
+	ValueType expected, result;
+	do
+	{
+		expected = *acc;
+		result = v_prog->op(expected, value);
+	}while(!__atomic_compare_exchange(acc, &expected, &result, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	return memcmp(&expected, &result, sizeof(ValueType));
+}
 
+template<class KeyType, class ValueType>
+inline bool MessageBuffer<KeyType, ValueType>::accumulate(ValueType *acc, const ValueType &value, std::false_type lock_free)
+{
+	std::lock_guard<std::mutex> lock(sync_lock[((uintptr_t)acc / sizeof(ValueType)) % SYNC_LOCKS]);
+	*acc = v_prog->op(*acc, value);
+	return true;
+}
+
+
+// the sync messages are processed by the engine that sent them, which knows their wire type
 template<class KeyType, class ValueType>
 inline void MessageBuffer<KeyType, ValueType>::process_mesg(int tag, void *buf)
 {
 	//char* mark = (char*)buf;
+	if(handler && handler->process_mesg(tag, buf))
+		return;
 	switch(tag)
 	{
 		case EDGE:
@@ -104,80 +242,10 @@ inline void MessageBuffer<KeyType, ValueType>::process_mesg(int tag, void *buf)
 			// buf_size = edge_buf.size();
 			break;
 		}
-		case SYNC_MASTER_LOW:
-		{
-			int size = ((SyncMesg *)buf)->id;
-			for (int i = 1; i < size + 1; ++i)
-			{
-				SyncMesg *mesg = (SyncMesg *)buf+i;
-				KeyType lid = graph->gtol_low_master[mesg->id];
-				ValueType expected, acc;
-				do
-				{
-					expected = sync_buf_low[lid];
-					acc = v_prog->op(sync_buf_low[lid], mesg->value);
-				}while(!__atomic_compare_exchange(sync_buf_low + lid, &expected, &acc, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
-				// VertexType &v = (graph->low_degree_master).find(mesg->id);
-				// __sync_bool_compare_and_swap(&(v.value), v.value, op<KeyType, ValueType>(v.value, mesg->value));
-			}
-			free(buf);
-			break;
-		}
-		case SYNC_MASTER_HIGH:
-		{
-			int size = ((SyncMesg *)buf)->id;
-			for (int i = 1; i < size + 1; ++i)
-			{
-				SyncMesg *mesg = (SyncMesg *)buf+i;
-				KeyType lid = graph->gtol_high_master[mesg->id];
-				// log("rank: %d, LID: %d, GID: %d\n", rank, lid, mesg->id);
-				ValueType expected, acc;
-				do
-				{
-					expected = sync_buf_high[lid];
-					acc = v_prog->op(sync_buf_high[lid], mesg->value);
-				}while(!__atomic_compare_exchange(sync_buf_high + lid, &expected, &acc, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
-				// VertexType &v = (graph->high_degree_master).find(mesg->id);
-				// __sync_bool_compare_and_swap(&(v.value), v.value, op<KeyType, ValueType>(v.value, mesg->value));
-			}
-			free(buf);
-			break;
-		}
-		case SYNC_MIRROR_LOW:
-		{
-			int size = ((SyncMesg *)buf)->id;
-			for (int i = 1; i < size + 1; ++i)
-			{
-				SyncMesg *mesg = (SyncMesg *)buf+i;
-				// if(graph->low_degree_mirror.end() == (graph->low_degree_mirror).find(mesg->id))
-				// 	log("rank: %d, ID: %d, NO MIRROR\n", rank, mesg->id);
-				VertexType &v = ((graph->low_degree_mirror).find(mesg->id))->second;
-				ValueType old_value = v.get_value();
-				v.set_value(mesg->value);
-				v.change = v.get_value() - old_value;
-				// log("Note:rank: %d, ID:%d old_value:%d, new_value:%d\n", rank, mesg->id, old_value, v.get_value());
-			}
-			free(buf);
-			break;
-		}
-		case SYNC_MIRROR_HIGH:
-		{
-			int size = ((SyncMesg *)buf)->id;
-			for (int i = 1; i < size + 1; ++i)
-			{
-				SyncMesg *mesg = (SyncMesg *)buf+i;
-				VertexType &v = ((graph->high_degree_mirror).find(mesg->id))->second;
-				ValueType old_value = v.get_value();
-				v.set_value(mesg->value);
-				v.change = v.get_value() - old_value;
-			}
-			free(buf);
-			break;
-		}
 		case ACT:
 		{
-			int size = ((ActMesg *)buf)->id;
-			for (int i = 1; i < size + 1; ++i)
+			size_t size = ((ActMesg *)buf)->id;
+			for (size_t i = 1; i < size + 1; ++i)
 			{
 				ActMesg *mesg = (ActMesg *)buf+i;
 				if(rank == graph->hash(mesg->id))
@@ -193,4 +261,4 @@ inline void MessageBuffer<KeyType, ValueType>::process_mesg(int tag, void *buf)
 }
 
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "controller.hpp"
+#include "graph.hpp"
+#include "engine.hpp"
+#include "vertexprogram.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <ctype.h>
+
+// sources computed together, one lane each
+#define LANES 16
+typedef Lanes<float, LANES> Distances;
+
+/*
+	shortest paths from a batch of sources at once: every vertex holds one distance per source,
+	gather, apply and scatter work on all the lanes together, and a vertex is active while any lane improves
+*/
+template<class KeyType, class ValueType>
+class MultiSssp: public VertexProgram<KeyType, ValueType>
+{
+private:
+	typedef Vertex<KeyType, ValueType> VertexType;
+
+public:
+	// sources of the current batch, the lanes after num_sources are unused
+	static KeyType sources[LANES];
+	static int num_sources;
+	MultiSssp() {this->iterations = 64; this->acc_init = fill_lanes<float, LANES>(1 << 30);}
+	~MultiSssp() {}
+
+	static bool is_source(KeyType id)
+	{
+		for(int i = 0; i < num_sources; ++i)
+			if(sources[i] == id)
+				return true;
+		return false;
+	}
+
+	EDGE_DIRECTION gather_edge() {return IN_EDGES;}
+	// a source still gathers the lanes of the other sources
+	EDGE_DIRECTION gather_edge(VertexType &v) {return IN_EDGES;}
+
+	EDGE_DIRECTION scatter_edge() {return OUT_EDGES;}
+	EDGE_DIRECTION scatter_edge(VertexType &v)
+	{
+		if(!v.get_change())
+			return NO_EDGES;
+		else
+			return OUT_EDGES;
+	}
+
+	ValueType gather(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		return nbr.get_value() + weight;
+	}
+
+	ValueType op(ValueType x, ValueType y)
+	{
+		return lane_min(x, y);
+	}
+
+	// values only decrease, as in sssp
+	bool fused_apply() {return true;}
+
+	void apply(VertexType &v, ValueType total)
+	{
+		ValueType old_value = v.get_value();
+		ValueType value = lane_min(old_value, total);
+		for(int i = 0; i < num_sources; ++i)
+			if(sources[i] == v.get_id())
+				value.lane[i] = 0;
+		v.set_value(value);
+		v.set_change(v.get_value() - old_value);
+	}
+
+	bool scatter(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		return any_less(v.get_value() + weight, nbr.get_value());
+	}
+
+	static bool init_vertex(VertexType &v)
+	{
+		v.set_value(fill_lanes<float, LANES>(1 << 30));
+		v.set_active(is_source(v.get_id()));
+		return v.is_active();
+	}
+
+};
+
+template<class KeyType, class ValueType>
+KeyType MultiSssp<KeyType, ValueType>::sources[LANES];
+template<class KeyType, class ValueType>
+int MultiSssp<KeyType, ValueType>::num_sources = 0;
+
+// the distances from the sources of the batch in the text results
+template<>
+struct TextValue<Distances>
+{
+	static inline int format(char *buf, size_t len, const Distances &value)
+	{
+		int n = 0;
+		for(int i = 0; i < MultiSssp<VertexId, Distances>::num_sources; ++i)
+			n += snprintf(buf + std::min((size_t)n, len), len - std::min((size_t)n, len), i ? " %.9g" : "%.9g", value.lane[i]);
+		return n;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	char *file_path = NULL;
+	size_t threshold = 1000;
+	int reorder_type = REORDER_NONE;
+	bool compressed = false;
+	bool weighted = false;
+	int id_bits = 32;
+	std::vector<VertexId> sources;
+	int batch = LANES;
+	char *output = NULL;
+	int output_type = OUTPUT_TEXT;
+
+    while ((opt = getopt(argc, argv, "g:t:s:b:r:cwi:o:O:")) != -1) {
+        switch (opt) {
+        case 'g':
+            file_path = optarg;
+            break;
+        case 't':
+            threshold = (size_t)atoi(optarg);
+            break;
+        case 'r':
+            reorder_type = atoi(optarg);
+            break;
+        case 'c':
+            compressed = true;
+            break;
+        case 'w':
+            weighted = true;
+            break;
+        case 'i':
+            id_bits = atoi(optarg);
+            break;
+        case 's':
+        {
+        	// comma separated, anything else is a bad source
+        	char *ptr = optarg, *end;
+        	while(true)
+        	{
+        		VertexId source = strtoull(ptr, &end, 10);
+        		if(!isdigit((unsigned char)*ptr) || (*end && ',' != *end))
+        		{
+        			sources.clear();
+        			break;
+        		}
+        		sources.push_back(source);
+        		if(!*end)
+        			break;
+        		ptr = end + 1;
+        	}
+        	if(sources.empty())
+        	{
+        		fprintf(stderr, "Bad sources: %s\n", optarg);
+        		fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-s sources, comma separated] [-b sources per batch] [-r reorder] [-c] [-w] [-i id bits] [-o output] [-O output type]\n", argv[0]);
+        		exit(EXIT_FAILURE);
+        	}
+        	break;
+        }
+        case 'b':
+        	batch = atoi(optarg);
+        	break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'O':
+            output_type = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-s sources, comma separated] [-b sources per batch] [-r reorder] [-c] [-w] [-i id bits] [-o output] [-O output type]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+	if (file_path == NULL || sources.empty() || batch < 1 || batch > LANES) {
+		fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-s sources, comma separated] [-b sources per batch, at most %d] [-r reorder] [-c] [-w] [-i id bits] [-o output] [-O output type]\n", argv[0], LANES);
+		exit(EXIT_FAILURE);
+	}
+
+	typedef MultiSssp<VertexId, Distances> ProgType;
+	Controller<VertexId, Distances> controller;
+	ProgType msssp;
+
+	Graph<VertexId, Distances> graph(&controller, file_path, threshold, fill_lanes<float, LANES>(1), reorder_type, compressed, weighted, id_bits);
+	graph.transform_vertices(ProgType::init_vertex);
+
+	// the graph is loaded once, and its values reset for every batch
+	double start = MPI_Wtime();
+	int num_batches = 0;
+	for(size_t first = 0; first < sources.size(); first += batch)
+	{
+		ProgType::num_sources = std::min(sources.size() - first, (size_t)batch);
+		std::copy(sources.begin() + first, sources.begin() + first + ProgType::num_sources, ProgType::sources);
+		graph.reset_vertices(ProgType::init_vertex);
+
+		Engine<VertexId, Distances> engine(&controller, &graph, &msssp);
+		engine.run();
+		if(output)
+			graph.write_values((std::string(output) + "." + std::to_string(num_batches)).c_str(), output_type);
+		num_batches++;
+	}
+	double total = MPI_Wtime() - start;
+	if(0 == controller.comm->get_rank())
+		printf("Sources: %lu, batches: %d, total time: %lf (s), sources per second: %lf\n", sources.size(), num_batches, total, sources.size() / total);
+	return 0;
+}
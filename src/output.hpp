@@ -0,0 +1,54 @@
+#ifndef OUTPUT
+#define OUTPUT
+
+#include <stdio.h>
+#include <type_traits>
+#include <limits>
+
+/*
+	type of the result files written by Graph::write_values, the bits can be combined
+*/
+typedef enum
+{
+	OUTPUT_TEXT = 0, // "id value" lines, one file per rank: path.rank
+	OUTPUT_BINARY = 1, // id and value records, the value packed by its Serializer
+	OUTPUT_SINGLE = 2, // a single file, written by all ranks through MPI-IO
+	OUTPUT_ADJACENCY = 4 // binary records carry a fingerprint of the edges of the vertex after the id, for a warm start
+} OUTPUT_TYPE;
+
+/*
+	text of a value in the results, format() writes at most len bytes into buf like snprintf and returns the length
+	of the whole text, numbers are written as such, other types need a specialization, e.g. one number per field
+*/
+template<class T, class Enable = void>
+struct TextValue;
+
+template<class T>
+struct TextValue<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+	// enough digits to read the same value back
+	static inline int format(char *buf, size_t len, const T &value)
+	{
+		return snprintf(buf, len, "%.*g", std::numeric_limits<T>::max_digits10, (double)value);
+	}
+};
+
+template<class T>
+struct TextValue<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type>
+{
+	static inline int format(char *buf, size_t len, const T &value)
+	{
+		return snprintf(buf, len, "%lld", (long long)value);
+	}
+};
+
+template<class T>
+struct TextValue<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type>
+{
+	static inline int format(char *buf, size_t len, const T &value)
+	{
+		return snprintf(buf, len, "%llu", (unsigned long long)value);
+	}
+};
+
+#endif
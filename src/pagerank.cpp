@@ -1,68 +1,10 @@
 
 #include "controller.hpp"
 #include "graph.hpp"
+#include "stream.hpp"
 #include "engine.hpp"
-#include "vertexprogram.hpp"
-
-template<class KeyType, class ValueType>
-class PageRank: public VertexProgram<KeyType, ValueType>
-{
-private:
-	ValueType delta = 1.0E-9;
-	//ValueType change;
-	const double res_prob = 0.85;
-	typedef Vertex<KeyType, ValueType> VertexType;
-public:
-	PageRank() {this->iterations = 32; this->acc_init = 0;}
-	~PageRank() {}
-
-	EDGE_DIRECTION gather_edge() {return IN_EDGES;}
-	EDGE_DIRECTION gather_edge(VertexType &v) {return IN_EDGES;}
-
-	EDGE_DIRECTION scatter_edge() {return OUT_EDGES;}
-	EDGE_DIRECTION scatter_edge(VertexType &v)
-	{
-		// if(v.change > delta || v.change < -delta)
-		// {
-			// log("Note:ID:%d, change:%.10lf, delta:%.10lf\n", v.get_id(), v.change, delta);
-			return OUT_EDGES;
-		// }
-		// else
-			// return NO_EDGES;
-	}
-
-	ValueType gather(VertexType &v, VertexType &nbr)
-	{
-		return nbr.get_value() / nbr.out_nbrs_v.size();
-	}
-
-	ValueType op(ValueType x, ValueType y)
-	{
-		return x + y;
-	}
-
-	void apply(VertexType &v, ValueType total)
-	{
-		ValueType old_value = v.get_value();
-		v.set_value((1 - res_prob) * total + res_prob);
-		v.change = v.get_value() - old_value;
-		// if(v.change <= delta && v.change >= -delta)
-			v.change = 1;
-		// log("INFO:id:%d, new value:%lf, old_value:%lf\n", v.get_id(), v.get_value(), old_value);
-	}
-
-	bool scatter(VertexType &v, VertexType &nbr)
-	{
-		return true;
-	}
-
-	static bool init_vertex(VertexType &v)
-	{
-		v.set_value(1);
-		return true;
-	}
-
-};
+#include "ssp_engine.hpp"
+#include "pagerank.hpp"
 
 template<class KeyType, class ValueType>
 ValueType op(ValueType x, ValueType y)
@@ -75,8 +17,23 @@ int main(int argc, char *argv[])
 	int opt;
 	char *file_path = NULL;
 	size_t threshold = 1000;
-
-    while ((opt = getopt(argc, argv, "g:t:")) != -1) {
+	int reorder_type = REORDER_NONE;
+	bool compressed = false;
+	bool weighted = false;
+	int id_bits = 32;
+	char *output = NULL;
+	int output_type = OUTPUT_TEXT;
+	char *checkpoint = NULL;
+	int period = 10;
+	bool restart = false;
+	char *prior = NULL;
+	char *updates = NULL;
+	char *feed = NULL;
+	double tolerance = 0;
+	bool delta_caching = false;
+	int staleness = -1;
+
+    while ((opt = getopt(argc, argv, "g:t:r:cwi:e:dS:o:O:W:U:F:C:P:R")) != -1) {
         switch (opt) {
         case 'g':
             file_path = optarg;
@@ -84,28 +41,122 @@ int main(int argc, char *argv[])
         case 't':
             threshold = (size_t)atoi(optarg);
             break;
+        case 'r':
+            reorder_type = atoi(optarg);
+            break;
+        case 'c':
+            compressed = true;
+            break;
+        case 'w':
+            weighted = true;
+            break;
+        case 'i':
+            id_bits = atoi(optarg);
+            break;
+        case 'e':
+            tolerance = atof(optarg);
+            break;
+        case 'd':
+            delta_caching = true;
+            break;
+        case 'S':
+            staleness = atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'O':
+            output_type = atoi(optarg);
+            break;
+        case 'C':
+            checkpoint = optarg;
+            break;
+        case 'P':
+            period = atoi(optarg);
+            break;
+        case 'R':
+            restart = true;
+            break;
+        case 'W':
+            prior = optarg;
+            break;
+        case 'U':
+            updates = optarg;
+            break;
+        case 'F':
+            feed = optarg;
+            break;
         default:
-            fprintf(stderr, "Usage: %s [-g graph] [-t threshold]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-r reorder] [-c] [-w] [-i id bits] [-e tolerance] [-d] [-S staleness] [-o output] [-O output type] [-W prior results] [-U edge updates] [-F edge stream] [-C checkpoint] [-P checkpoint period] [-R]\n", argv[0]);
             exit(EXIT_FAILURE);
         }
     }
 
 	if (file_path == NULL) {
-		fprintf(stderr, "Usage: %s [-g graph] [-t threshold]\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-r reorder] [-c] [-w] [-i id bits] [-e tolerance] [-d] [-S staleness] [-o output] [-O output type] [-W prior results] [-U edge updates] [-F edge stream] [-C checkpoint] [-P checkpoint period] [-R]\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
-	Controller<unsigned int, double> controller;
+	Controller<VertexId, double> controller;
 
 	// volatile int set_break = 0;
 	// if(controller.comm->get_rank() != 0)
 	// 	set_break = 0;
 	// while(set_break);
 
-	PageRank<unsigned int, double> pagerank;
-	Graph<unsigned int, double> graph(&controller, file_path, threshold, 1);
-	graph.transform_vertices(PageRank<unsigned int, double>::init_vertex);
-	Engine<unsigned int, double> engine(&controller, &graph, &pagerank);
-	engine.run();
+	PageRank<VertexId, double> pagerank;
+	pagerank.tolerance = tolerance;
+	// the aggregator is only needed to stop early, and it would bound the staleness to one
+	if(tolerance > 0)
+		pagerank.aggregators.push_back(&pagerank.l1_delta);
+	pagerank.delta_caching = delta_caching;
+	Graph<VertexId, double> graph(&controller, file_path, threshold, 1, reorder_type, compressed, weighted, id_bits);
+	graph.transform_vertices(PageRank<VertexId, double>::init_vertex, prior);
+	auto run = [&]()
+	{
+		if(staleness >= 0 && SspEngine<VertexId, double, PageRank<VertexId, double>::WireType>::supported(&controller, &pagerank))
+		{
+			SspEngine<VertexId, double, PageRank<VertexId, double>::WireType> engine(&controller, &graph, &pagerank, staleness);
+			engine.run();
+		}
+		else
+		{
+			Engine<VertexId, double, PageRank<VertexId, double>::WireType> engine(&controller, &graph, &pagerank);
+			// only the run on the loaded graph is checkpointed
+			if(checkpoint)
+				engine.set_checkpoint(checkpoint, period, restart);
+			checkpoint = NULL;
+			engine.run();
+		}
+	};
+	run();
+
+	// then from the ranks of the graph before the updates
+	if(updates)
+	{
+		std::vector<EdgeUpdate<VertexId> > batch;
+		if(0 == controller.comm->get_rank() && !read_updates(updates, batch))
+		{
+			fprintf(stderr, "Cannot read %s\n", updates);
+			MPI_Abort(controller.comm->mpi_comm, EXIT_FAILURE);
+		}
+		graph.update_edges(batch, PageRank<VertexId, double>::init_vertex);
+		run();
+	}
+	// and round after round from the updates arriving on the stream, until it ends
+	if(feed)
+	{
+		EdgeStream<VertexId, double> stream(&controller, &graph, feed);
+		std::vector<EdgeUpdate<VertexId> > batch;
+		while(stream.next(batch))
+		{
+			graph.update_edges(batch, PageRank<VertexId, double>::init_vertex);
+			run();
+			stream.visible();
+		}
+	}
+
+	if(output)
+		graph.write_values(output, output_type);
 	return 0;
 }
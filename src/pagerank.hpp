@@ -0,0 +1,98 @@
+#ifndef PAGERANK
+#define PAGERANK
+
+#include "vertexprogram.hpp"
+#include "log.h"
+#include <math.h>
+
+template<class KeyType, class ValueType>
+class PageRank: public VertexProgram<KeyType, ValueType>
+{
+private:
+	ValueType delta = 1.0E-9;
+	//ValueType change;
+	const double res_prob = 0.85;
+	typedef Vertex<KeyType, ValueType> VertexType;
+public:
+	// ranks are accumulated in ValueType and sent to other ranks in float
+	typedef float WireType;
+	// stop once the L1 norm of the changes of an iteration is below tolerance, 0 runs all iterations
+	double tolerance = 0;
+	Aggregator<double> l1_delta;
+	// reuse the gathered ranks and only scatter from the vertices whose rank changed by more than delta
+	bool delta_caching = false;
+
+	PageRank(): l1_delta(Aggregator<double>::sum, 0)
+	{
+		this->iterations = 32;
+		this->acc_init = 0;
+	}
+	~PageRank() {}
+
+	EDGE_DIRECTION gather_edge() {return IN_EDGES;}
+	EDGE_DIRECTION gather_edge(VertexType &v) {return IN_EDGES;}
+
+	EDGE_DIRECTION scatter_edge() {return OUT_EDGES;}
+	EDGE_DIRECTION scatter_edge(VertexType &v)
+	{
+		if(!delta_caching || v.get_change() > delta || v.get_change() < -delta)
+		{
+			// log("Note:ID:%d, change:%.10lf, delta:%.10lf\n", v.get_id(), v.get_change(), delta);
+			return OUT_EDGES;
+		}
+		else
+			return NO_EDGES;
+	}
+
+	ValueType gather(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		return nbr.get_value() / nbr.out_nbrs_size();
+	}
+
+	bool dense_gather() {return true;}
+	ValueType contribution(VertexType &v)
+	{
+		return v.out_nbrs_size() ? v.get_value() / v.out_nbrs_size() : 0;
+	}
+
+	bool delta_cache() {return delta_caching;}
+	ValueType gather_delta(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		return nbr.get_change() / nbr.out_nbrs_size();
+	}
+
+	ValueType op(ValueType x, ValueType y)
+	{
+		return x + y;
+	}
+
+	void apply(VertexType &v, ValueType total)
+	{
+		ValueType old_value = v.get_value();
+		v.set_value((1 - res_prob) * total + res_prob);
+		v.set_change(v.get_value() - old_value);
+		if(tolerance > 0)
+			l1_delta.add(fabs(v.get_change()));
+		// log("INFO:id:%d, new value:%lf, old_value:%lf\n", v.get_id(), v.get_value(), old_value);
+	}
+
+	bool scatter(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		return true;
+	}
+
+	bool terminate()
+	{
+		log("L1 delta: %lf\n", l1_delta.get());
+		return l1_delta.get() < tolerance;
+	}
+
+	static bool init_vertex(VertexType &v)
+	{
+		v.set_value(1);
+		return true;
+	}
+
+};
+
+#endif
@@ -33,6 +33,26 @@ bool operator!(const VecValue& v) {
 	return v.value[0] == 0;
 }
 
+// VecValue holds its data out of line, so it is packed into the messages element by element
+template<>
+struct Serializer<VecValue>
+{
+	static const bool fixed = false;
+	static inline size_t size(const VecValue &v) {return Serializer<std::vector<int> >::size(v.value);}
+	static inline char *pack(char *buf, const VecValue &v) {return Serializer<std::vector<int> >::pack(buf, v.value);}
+	static inline const char *unpack(const char *buf, VecValue &v) {return Serializer<std::vector<int> >::unpack(buf, v.value);}
+};
+
+// the hop distance in the text results, as sssp writes it
+template<>
+struct TextValue<VecValue>
+{
+	static inline int format(char *buf, size_t len, const VecValue &v)
+	{
+		return snprintf(buf, len, "%d", v.value[0]);
+	}
+};
+
 template<class KeyType, class ValueType>
 class Ring: public VertexProgram<KeyType, ValueType>
 {
@@ -58,13 +78,13 @@ public:
 	EDGE_DIRECTION scatter_edge() {return OUT_EDGES;}
 	EDGE_DIRECTION scatter_edge(VertexType &v)
 	{
-		if(delta != v.change)
+		if(delta != v.get_change())
 			return OUT_EDGES;
 		else
 			return NO_EDGES;
 	}
 
-	ValueType gather(VertexType &v, VertexType &nbr)
+	ValueType gather(VertexType &v, VertexType &nbr, WeightType weight)
 	{
 		return nbr.get_value();
 	}
@@ -80,11 +100,11 @@ public:
 		v.set_value({std::min(old_value, total + 1)});
 		if(v.get_id() == source)
 			v.set_value(VecValue{{0}});
-		v.change = {v.get_value() - old_value};
+		v.set_change({v.get_value() - old_value});
 		// log("Warning: %d: old_value:%d, new_value:%d\n", v.get_id(), old_value, v.get_value());
 	}
 
-	bool scatter(VertexType &v, VertexType &nbr)
+	bool scatter(VertexType &v, VertexType &nbr, WeightType weight)
 	{
 		if(v.get_value() + 1 < nbr.get_value())
 		{
@@ -100,13 +120,13 @@ public:
 		if(v.get_id() == source)
 		{
 			v.set_value(VecValue {{1 << 30}});
-			v.is_active = true;
+			v.set_active(true);
 			return true; // active
 		}
 		else
 		{
 			v.set_value(VecValue {{1 << 30}});
-			v.is_active = false;
+			v.set_active(false);
 			return false; // inactive
 		}
 	}
@@ -122,25 +142,65 @@ ValueType op(ValueType x, ValueType y)
 template<class KeyType, class ValueType>
 KeyType Ring<KeyType, ValueType>::source = 0;
 
-int main(int argc, char const *argv[])
+int main(int argc, char *argv[])
 {
-	Controller<unsigned int, VecValue> controller(argc, argv);
-
-	char const *file_path = argv[1];
-	int threshold = 1000;
-	if(argc >= 3)
-		threshold = (size_t)atoi(argv[2]);
-	if(argc >= 4)
-		Ring<unsigned int, VecValue>::source = atoi(argv[3]);
+	int opt;
+	char *file_path = NULL;
+	size_t threshold = 1000;
+	int reorder_type = REORDER_NONE;
+	bool compressed = false;
+	int id_bits = 32;
+	char *output = NULL;
+	int output_type = OUTPUT_TEXT;
+
+    while ((opt = getopt(argc, argv, "g:t:s:r:ci:o:O:")) != -1) {
+        switch (opt) {
+        case 'g':
+            file_path = optarg;
+            break;
+        case 't':
+            threshold = (size_t)atoi(optarg);
+            break;
+        case 'r':
+            reorder_type = atoi(optarg);
+            break;
+        case 'c':
+            compressed = true;
+            break;
+        case 'i':
+            id_bits = atoi(optarg);
+            break;
+        case 's':
+        	Ring<VertexId, VecValue>::source = strtoull(optarg, NULL, 10);
+        	break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'O':
+            output_type = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-s source] [-r reorder] [-c] [-i id bits] [-o output] [-O output type]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+	if (file_path == NULL) {
+		fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-s source] [-r reorder] [-c] [-i id bits] [-o output] [-O output type]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
 
-	log("threshold:%d\n", threshold);
+	Controller<VertexId, VecValue> controller;
 
-	Ring<unsigned int, VecValue> ring;
+	Ring<VertexId, VecValue> ring;
 	
-	Graph<unsigned int, VecValue> graph(&controller, file_path, threshold, VecValue{{1}});
-	graph.transform_vertices(Ring<unsigned int, VecValue>::init_vertex);
+	Graph<VertexId, VecValue> graph(&controller, file_path, threshold, VecValue{{1}}, reorder_type, compressed, false, id_bits);
+	graph.transform_vertices(Ring<VertexId, VecValue>::init_vertex);
 	
-	Engine<unsigned int, VecValue> engine(&controller, &graph, &ring);
+	Engine<VertexId, VecValue> engine(&controller, &graph, &ring);
 	engine.run();
+
+	if(output)
+		graph.write_values(output, output_type);
 	return 0;
-}
\ No newline at end of file
+}
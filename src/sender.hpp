@@ -11,6 +11,8 @@ private:
 	{
 		MesgType * mesg;
 		int len;
+		size_t bytes; // used bytes of a block of variable size messages, 0 for fixed size ones
+		size_t capacity;
 	}TableEntry;
 
 	const int block_len = 1000;
@@ -18,9 +20,12 @@ private:
 	int size;
 	int tag;
 	TableEntry *table;
+	size_t num_blocks = 0;
 	std::vector<MesgType *> sent_block;
 	std::vector<MPI_Request> requests;
 
+	inline void send_block(int target);
+
 public:
 	Sender(Communicator *comm, int tag):comm(comm), tag(tag)
 	{
@@ -31,52 +36,87 @@ public:
 	~Sender() {delete []table;}
 
 	inline MesgType *get_bucket(int target);
+	inline char *get_bytes(int target, size_t bytes);
 	inline void flush();
 	inline int test_all();
+	// number of blocks sent so far
+	inline size_t sent_blocks() const {return num_blocks;}
 };
 
 
+template<class MesgType>
+inline void Sender<MesgType>::send_block(int target)
+{
+	TableEntry &entry = table[target];
+	size_t bytes = entry.bytes ? entry.bytes : sizeof(MesgType) * block_len;
+	entry.mesg->id = entry.len - 1;
+	num_blocks++;
+	sent_block.push_back(entry.mesg);
+	MPI_Request req;
+	comm->issend(target, tag, entry.mesg, bytes, &req);
+	requests.push_back(req);
+	entry.mesg = NULL;
+}
+
 template<class MesgType>
 inline MesgType *Sender<MesgType>::get_bucket(int target)
 {
-	MesgType *block_ptr = table[target].mesg;
-	if(!block_ptr)
+	if(table[target].mesg && block_len == table[target].len)
+		send_block(target);
+	if(!table[target].mesg)
 	{
-		block_ptr = (MesgType *)malloc(sizeof(MesgType) * block_len);
-		table[target].mesg = block_ptr;
+		table[target].mesg = (MesgType *)malloc(sizeof(MesgType) * block_len);
 		table[target].len = 1;
 	}
-	else
-		if(block_len == table[target].len)
-		{
-			(table[target].mesg)->id = block_len - 1;
-			sent_block.push_back(table[target].mesg);
-			MPI_Request req;
-			comm->issend(target, tag, table[target].mesg, sizeof(MesgType) * block_len, &req);
-			requests.push_back(req);
+	return table[target].mesg + table[target].len++;
+}
 
-			block_ptr = (MesgType *)malloc(sizeof(MesgType) * block_len);
-			table[target].mesg = block_ptr;
-			table[target].len = 1;
-		}
-	return block_ptr + table[target].len++;
+/*
+	room for a message of variable size, the first MesgType of the block still holds the count
+	a block grows beyond block_len messages only to fit a single large message
+*/
+template<class MesgType>
+inline char *Sender<MesgType>::get_bytes(int target, size_t bytes)
+{
+	TableEntry &entry = table[target];
+	if(entry.mesg && entry.bytes + bytes > entry.capacity)
+		send_block(target);
+	if(!entry.mesg)
+	{
+		entry.capacity = std::max(sizeof(MesgType) * block_len, sizeof(MesgType) + bytes);
+		entry.mesg = (MesgType *)malloc(entry.capacity);
+		entry.len = 1;
+		entry.bytes = sizeof(MesgType);
+	}
+	char *ptr = (char *)entry.mesg + entry.bytes;
+	entry.bytes += bytes;
+	entry.len++;
+	return ptr;
 }
 
 template<class MesgType>
 inline void Sender<MesgType>::flush()
 {
+	TRACE_SCOPE("flush");
 	for (int target = 0; target < size; ++target)
 	{
 		if(table[target].mesg != NULL)
 		{
+			size_t bytes = table[target].bytes ? table[target].bytes : sizeof(MesgType) * block_len;
 			table[target].mesg->id = table[target].len - 1;
-			comm->ssend(target, tag, table[target].mesg, sizeof(MesgType) * block_len);
-			free(table[target].mesg);			
+			num_blocks++;
+			comm->ssend(target, tag, table[target].mesg, bytes);
+			free(table[target].mesg);
+			table[target].mesg = NULL;
+			table[target].bytes = 0;
 		}
 	}
 	MPI_Waitall(requests.size(), &requests[0], MPI_STATUSES_IGNORE);
 	for(auto block_ptr : sent_block)
 		free(block_ptr);
+	// the sender can be filled again after a flush
+	sent_block.clear();
+	requests.clear();
 }
 
 template<class MesgType>
@@ -109,4 +149,4 @@ inline int Sender<MesgType>::test_all()
 // 		}
 // 	}
 	
-// }
\ No newline at end of file
+// }
\ No newline at end of file
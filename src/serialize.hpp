@@ -0,0 +1,67 @@
+#ifndef SERIALIZE
+#define SERIALIZE
+
+#include <vector>
+#include <type_traits>
+#include <string.h>
+#include <stdint.h>
+
+/*
+	serialization of values in messages
+	trivially copyable types are fixed: they are copied in place and keep the fixed size messages,
+	other types are packed after their message, prefixed by their length in bytes
+	specialize Serializer with size, pack and unpack for such types, e.g. from Serializer<std::vector<T> >
+*/
+template<class T, bool = std::is_trivially_copyable<T>::value>
+struct Serializer
+{
+	static const bool fixed = true;
+	static inline size_t size(const T &value) {return sizeof(T);}
+	static inline char *pack(char *buf, const T &value)
+	{
+		memcpy(buf, &value, sizeof(T));
+		return buf + sizeof(T);
+	}
+	static inline const char *unpack(const char *buf, T &value)
+	{
+		memcpy(&value, buf, sizeof(T));
+		return buf + sizeof(T);
+	}
+};
+
+// number of elements followed by the elements
+template<class T>
+struct Serializer<std::vector<T>, false>
+{
+	static const bool fixed = false;
+	static inline size_t size(const std::vector<T> &value)
+	{
+		size_t bytes = sizeof(uint32_t);
+		if(Serializer<T>::fixed)
+			return bytes + sizeof(T) * value.size();
+		for(auto &element : value)
+			bytes += Serializer<T>::size(element);
+		return bytes;
+	}
+	static inline char *pack(char *buf, const std::vector<T> &value)
+	{
+		uint32_t num = value.size();
+		memcpy(buf, &num, sizeof(uint32_t));
+		buf += sizeof(uint32_t);
+		for(auto &element : value)
+			buf = Serializer<T>::pack(buf, element);
+		return buf;
+	}
+	static inline const char *unpack(const char *buf, std::vector<T> &value)
+	{
+		uint32_t num;
+		memcpy(&num, buf, sizeof(uint32_t));
+		buf += sizeof(uint32_t);
+		value.resize(num);
+		for(auto &element : value)
+			buf = Serializer<T>::unpack(buf, element);
+		return buf;
+	}
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include "controller.hpp"
+#include "graph.hpp"
+#include "engine.hpp"
+#include "ssp_engine.hpp"
+#include "async_engine.hpp"
+#include "pagerank.hpp"
+#include "sssp.hpp"
+#include "cc.hpp"
+#include "kcore.hpp"
+#include <sys/stat.h>
+#include <errno.h>
+
+/*
+	resident graph server: the graph is loaded and partitioned once, then the programs run one job after another on it
+	jobs are lines written into a named pipe, a program with its options:
+		pagerank [-e tolerance] [-d] [-S staleness] [-o output] [-O output type]
+		sssp [-s source] [-d bucket width] [-a] [-S staleness] [-o output] [-O output type]
+		cc [-a] [-S staleness] [-o output] [-O output type]
+		kcore -k K [-o output] [-O output type]
+		quit
+	every program runs on double values, so that they share the graph, and the values are reset between the jobs
+	cc labels the vertices by their ids, which doubles hold exactly only up to 2^53, so its jobs are refused on graphs with larger ids
+	with -o, the values of the masters are written as by the applications (see Graph::write_values)
+*/
+
+typedef double ValueType;
+typedef Controller<VertexId, ValueType> ControllerType;
+typedef Graph<VertexId, ValueType> GraphType;
+typedef Vertex<VertexId, ValueType> VertexType;
+
+const int MAX_JOB_LEN = 4096;
+const int MAX_JOB_ARGS = 64;
+const uint64_t MAX_EXACT_ID = 1ULL << 53; // the largest id a double label holds exactly
+
+struct Job
+{
+	char *output = NULL;
+	int output_type = OUTPUT_TEXT;
+	double tolerance = 0;
+	bool delta_caching = false;
+	VertexId source = 0;
+	double width = 0;
+	bool async = false;
+	int staleness = -1;
+	int K = -1;
+};
+
+// the next line of the pipe, waiting for a writer once the last one closed it
+bool read_job(const char *fifo_path, char *line)
+{
+	static FILE *fifo = NULL;
+	while(true)
+	{
+		if(!fifo && !(fifo = fopen(fifo_path, "r")))
+		{
+			fprintf(stderr, "Cannot open %s: %s\n", fifo_path, strerror(errno));
+			return false;
+		}
+		if(fgets(line, MAX_JOB_LEN, fifo))
+			return true;
+		fclose(fifo);
+		fifo = NULL;
+	}
+}
+
+// the options of a job, the same on every rank, false if they are not valid for the program
+bool parse_job(int argc, char **argv, Job &job)
+{
+	const char *optstring;
+	if(!strcmp(argv[0], "pagerank"))
+		optstring = "e:dS:o:O:";
+	else if(!strcmp(argv[0], "sssp"))
+		optstring = "s:d:aS:o:O:";
+	else if(!strcmp(argv[0], "cc"))
+		optstring = "aS:o:O:";
+	else if(!strcmp(argv[0], "kcore"))
+		optstring = "k:o:O:";
+	else
+		return false;
+
+	// 0 starts getopt over on a new argv
+	optind = 0;
+	opterr = 0;
+	int opt;
+	bool sssp = !strcmp(argv[0], "sssp");
+	while ((opt = getopt(argc, argv, optstring)) != -1) {
+		switch (opt) {
+		case 'o':
+			job.output = optarg;
+			break;
+		case 'O':
+			job.output_type = atoi(optarg);
+			break;
+		case 'e':
+			job.tolerance = atof(optarg);
+			break;
+		case 'd':
+			if(sssp)
+				job.width = atof(optarg);
+			else
+				job.delta_caching = true;
+			break;
+		case 's':
+			job.source = strtoull(optarg, NULL, 10);
+			break;
+		case 'a':
+			job.async = true;
+			break;
+		case 'S':
+			job.staleness = atoi(optarg);
+			break;
+		case 'k':
+			job.K = atoi(optarg);
+			break;
+		default:
+			return false;
+		}
+	}
+	return optind == argc && !(!strcmp(argv[0], "kcore") && job.K < 0);
+}
+
+template<class ProgType>
+void run_program(ControllerType &controller, GraphType &graph, ProgType &prog, bool (*init_vertex)(VertexType &v), Job &job)
+{
+	graph.reset_vertices(init_vertex);
+	if(job.async)
+	{
+		AsyncEngine<VertexId, ValueType, typename ProgType::WireType> engine(&controller, &graph, &prog);
+		engine.run();
+	}
+	else if(job.staleness >= 0 && SspEngine<VertexId, ValueType, typename ProgType::WireType>::supported(&controller, &prog))
+	{
+		SspEngine<VertexId, ValueType, typename ProgType::WireType> engine(&controller, &graph, &prog, job.staleness);
+		engine.run();
+	}
+	else
+	{
+		Engine<VertexId, ValueType, typename ProgType::WireType> engine(&controller, &graph, &prog);
+		engine.run();
+	}
+}
+
+void run_job(ControllerType &controller, GraphType &graph, char *program, Job &job)
+{
+	if(!strcmp(program, "pagerank"))
+	{
+		PageRank<VertexId, ValueType> pagerank;
+		pagerank.tolerance = job.tolerance;
+		if(job.tolerance > 0)
+			pagerank.aggregators.push_back(&pagerank.l1_delta);
+		pagerank.delta_caching = job.delta_caching;
+		run_program(controller, graph, pagerank, PageRank<VertexId, ValueType>::init_vertex, job);
+	}
+	else if(!strcmp(program, "sssp"))
+	{
+		Sssp<VertexId, ValueType>::source = job.source;
+		Sssp<VertexId, ValueType>::width = job.width;
+		// the asynchronous engine applies in buckets, as wide as the mean edge weight unless -d is given
+		if(job.async && job.width <= 0)
+			Sssp<VertexId, ValueType>::width = graph.mean_edge_weight();
+		Sssp<VertexId, ValueType> sssp;
+		if(job.width > 0)
+			sssp.iterations = INT_MAX;
+		run_program(controller, graph, sssp, Sssp<VertexId, ValueType>::init_vertex, job);
+	}
+	else if(!strcmp(program, "cc"))
+	{
+		ConnectedComponent<VertexId, ValueType> cc;
+		run_program(controller, graph, cc, ConnectedComponent<VertexId, ValueType>::init_vertex, job);
+	}
+	else
+	{
+		KCore<VertexId, ValueType>::K = job.K;
+		KCore<VertexId, ValueType> kcore;
+		run_program(controller, graph, kcore, KCore<VertexId, ValueType>::init_vertex, job);
+	}
+}
+
+// nothing is active until the first job
+bool init_vertex(VertexType &v)
+{
+	v.set_value(0);
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	char *file_path = NULL;
+	char *fifo_path = NULL;
+	size_t threshold = 1000;
+	int reorder_type = REORDER_NONE;
+	bool compressed = false;
+	bool weighted = false;
+	int id_bits = 32;
+
+    while ((opt = getopt(argc, argv, "g:f:t:r:cwi:")) != -1) {
+        switch (opt) {
+        case 'g':
+            file_path = optarg;
+            break;
+        case 'f':
+            fifo_path = optarg;
+            break;
+        case 't':
+            threshold = (size_t)atoi(optarg);
+            break;
+        case 'r':
+            reorder_type = atoi(optarg);
+            break;
+        case 'c':
+            compressed = true;
+            break;
+        case 'w':
+            weighted = true;
+            break;
+        case 'i':
+            id_bits = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-f job pipe] [-t threshold] [-r reorder] [-c] [-w] [-i id bits]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+	if (file_path == NULL || fifo_path == NULL) {
+		fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-f job pipe] [-t threshold] [-r reorder] [-c] [-w] [-i id bits]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	ControllerType controller;
+	int rank = controller.comm->get_rank();
+	if(0 == rank && mkfifo(fifo_path, 0600) && EEXIST != errno)
+	{
+		fprintf(stderr, "Cannot create %s: %s\n", fifo_path, strerror(errno));
+		MPI_Abort(controller.comm->mpi_comm, EXIT_FAILURE);
+	}
+
+	GraphType graph(&controller, file_path, threshold, 1, reorder_type, compressed, weighted, id_bits);
+	graph.transform_vertices(init_vertex);
+
+	// the largest id of the graph, for the labels of cc
+	uint64_t max_id = 0;
+	for(auto &p : graph.low_degree_master)
+		max_id = std::max(max_id, (uint64_t)p.first);
+	for(auto &p : graph.high_degree_master)
+		max_id = std::max(max_id, (uint64_t)p.first);
+	MPI_Allreduce(MPI_IN_PLACE, &max_id, 1, MPI_UINT64_T, MPI_MAX, controller.comm->mpi_comm);
+	if(0 == rank)
+	{
+		printf("Waiting for jobs on %s\n", fifo_path);
+		fflush(stdout);
+	}
+
+	char line[MAX_JOB_LEN];
+	int num_jobs = 0;
+	while(true)
+	{
+		// rank 0 reads the job and every rank parses the same line
+		int len = 0;
+		if(0 == rank)
+		{
+			if(read_job(fifo_path, line))
+				len = strlen(line) + 1;
+			else
+				len = -1;
+		}
+		MPI_Bcast(&len, 1, MPI_INT, 0, controller.comm->mpi_comm);
+		if(len < 0)
+			break;
+		MPI_Bcast(line, len, MPI_CHAR, 0, controller.comm->mpi_comm);
+
+		char *job_argv[MAX_JOB_ARGS];
+		int job_argc = 0;
+		for(char *token = strtok(line, " \t\r\n"); token && job_argc < MAX_JOB_ARGS; token = strtok(NULL, " \t\r\n"))
+			job_argv[job_argc++] = token;
+		if(0 == job_argc)
+			continue;
+		if(!strcmp(job_argv[0], "quit"))
+			break;
+
+		Job job;
+		if(!parse_job(job_argc, job_argv, job))
+		{
+			if(0 == rank)
+			{
+				printf("Bad job: %s\n", job_argv[0]);
+				fflush(stdout);
+			}
+			continue;
+		}
+		if(!strcmp(job_argv[0], "cc") && max_id > MAX_EXACT_ID)
+		{
+			if(0 == rank)
+			{
+				printf("Bad job: cc, vertex id %llu has no exact double label\n", (unsigned long long)max_id);
+				fflush(stdout);
+			}
+			continue;
+		}
+
+		double start = MPI_Wtime();
+		run_job(controller, graph, job_argv[0], job);
+		if(job.output)
+			graph.write_values(job.output, job.output_type);
+		MPI_Barrier(controller.comm->mpi_comm);
+		num_jobs++;
+		if(0 == rank)
+		{
+			printf("Job %d: %s done, time: %lf (s)\n", num_jobs, job_argv[0], MPI_Wtime() - start);
+			fflush(stdout);
+		}
+	}
+	if(0 == rank)
+		printf("Jobs: %d\n", num_jobs);
+	return 0;
+}
@@ -0,0 +1,191 @@
+#ifndef SIMD
+#define SIMD
+
+#include <stddef.h>
+#include "vertex.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+	sum of array[index[i]] for i < n
+	vectorized with AVX-512 or AVX2 gathers when compiled for them (make NATIVE=1), scalar otherwise
+	the gathers take the indexes as signed 32 bits, so less than 2^31 local vertices are assumed
+*/
+template<class ValueType>
+inline ValueType gather_sum(const ValueType *array, const LocalId *index, size_t n)
+{
+	ValueType sum = ValueType();
+	for (size_t i = 0; i < n; ++i)
+		sum = sum + array[index[i]];
+	return sum;
+}
+
+#if defined(__AVX512F__)
+
+template<>
+inline double gather_sum<double>(const double *array, const LocalId *index, size_t n)
+{
+	__m512d acc = _mm512_setzero_pd();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i idx = _mm256_loadu_si256((const __m256i *)(index + i));
+		acc = _mm512_add_pd(acc, _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, idx, array, sizeof(double)));
+	}
+	double lanes[8];
+	_mm512_storeu_pd(lanes, acc);
+	double sum = 0;
+	for (int j = 0; j < 8; ++j)
+		sum += lanes[j];
+	for (; i < n; ++i)
+		sum += array[index[i]];
+	return sum;
+}
+
+template<>
+inline float gather_sum<float>(const float *array, const LocalId *index, size_t n)
+{
+	__m512 acc = _mm512_setzero_ps();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m512i idx = _mm512_loadu_si512((const void *)(index + i));
+		acc = _mm512_add_ps(acc, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, idx, array, sizeof(float)));
+	}
+	float lanes[16];
+	_mm512_storeu_ps(lanes, acc);
+	float sum = 0;
+	for (int j = 0; j < 16; ++j)
+		sum += lanes[j];
+	for (; i < n; ++i)
+		sum += array[index[i]];
+	return sum;
+}
+
+#elif defined(__AVX2__)
+
+template<>
+inline double gather_sum<double>(const double *array, const LocalId *index, size_t n)
+{
+	__m256d acc = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i idx = _mm_loadu_si128((const __m128i *)(index + i));
+		acc = _mm256_add_pd(acc, _mm256_i32gather_pd(array, idx, sizeof(double)));
+	}
+	__m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+	double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+	for (; i < n; ++i)
+		sum += array[index[i]];
+	return sum;
+}
+
+template<>
+inline float gather_sum<float>(const float *array, const LocalId *index, size_t n)
+{
+	__m256 acc = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i idx = _mm256_loadu_si256((const __m256i *)(index + i));
+		acc = _mm256_add_ps(acc, _mm256_i32gather_ps(array, idx, sizeof(float)));
+	}
+	__m128 quad = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+	quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+	float sum = _mm_cvtss_f32(_mm_add_ss(quad, _mm_shuffle_ps(quad, quad, 1)));
+	for (; i < n; ++i)
+		sum += array[index[i]];
+	return sum;
+}
+
+#endif
+
+/*
+	values of a batch of queries run together, one per lane (see msssp.cpp)
+	the lane-wise operations are loops of fixed length, which the compiler vectorizes,
+	with AVX2/AVX-512 when compiled for them (make NATIVE=1)
+*/
+template<class T, int N>
+struct Lanes
+{
+	T lane[N];
+};
+
+template<class T, int N>
+inline Lanes<T, N> fill_lanes(T value)
+{
+	Lanes<T, N> r;
+	for (int i = 0; i < N; ++i)
+		r.lane[i] = value;
+	return r;
+}
+
+template<class T, int N>
+inline Lanes<T, N> operator+(const Lanes<T, N> &a, const Lanes<T, N> &b)
+{
+	Lanes<T, N> r;
+	for (int i = 0; i < N; ++i)
+		r.lane[i] = a.lane[i] + b.lane[i];
+	return r;
+}
+
+// the same value added to every lane, e.g. an edge weight
+template<class T, int N, class S>
+inline Lanes<T, N> operator+(const Lanes<T, N> &a, S b)
+{
+	Lanes<T, N> r;
+	for (int i = 0; i < N; ++i)
+		r.lane[i] = a.lane[i] + b;
+	return r;
+}
+
+template<class T, int N>
+inline Lanes<T, N> operator-(const Lanes<T, N> &a, const Lanes<T, N> &b)
+{
+	Lanes<T, N> r;
+	for (int i = 0; i < N; ++i)
+		r.lane[i] = a.lane[i] - b.lane[i];
+	return r;
+}
+
+template<class T, int N>
+inline Lanes<T, N> lane_min(const Lanes<T, N> &a, const Lanes<T, N> &b)
+{
+	Lanes<T, N> r;
+	for (int i = 0; i < N; ++i)
+		r.lane[i] = b.lane[i] < a.lane[i] ? b.lane[i] : a.lane[i];
+	return r;
+}
+
+// whether any lane of a is less than the one of b, without a branch per lane
+template<class T, int N>
+inline bool any_less(const Lanes<T, N> &a, const Lanes<T, N> &b)
+{
+	int less = 0;
+	for (int i = 0; i < N; ++i)
+		less |= a.lane[i] < b.lane[i];
+	return less;
+}
+
+// true when every lane is zero, as for the change of a vertex that did not change
+template<class T, int N>
+inline bool operator!(const Lanes<T, N> &a)
+{
+	int nonzero = 0;
+	for (int i = 0; i < N; ++i)
+		nonzero |= a.lane[i] != 0;
+	return !nonzero;
+}
+
+template<class T, int N>
+inline bool operator!=(const Lanes<T, N> &a, const Lanes<T, N> &b)
+{
+	int differ = 0;
+	for (int i = 0; i < N; ++i)
+		differ |= a.lane[i] != b.lane[i];
+	return differ;
+}
+
+#endif
@@ -0,0 +1,389 @@
+#ifndef SSP_ENGINE
+#define SSP_ENGINE
+
+#include "engine.hpp"
+
+/*
+	stale synchronous mode of the superstep engine
+	instead of the barriers that close the phases, every rank announces its clock, the number of iterations it has
+	finished, and starts an iteration once the other ranks are at most staleness iterations behind
+	masters apply with the latest gathered values of their mirrors and mirrors keep the latest applied values,
+	both stamped with their iteration, so what a rank reads is about staleness iterations old at most
+	the values for the mirrors are held until the next iteration starts, so that no gather reads a value being written
+	the active vertices are counted by non-blocking reductions, read staleness + 1 iterations later, and the run stops
+	after staleness + 2 of them in a row found none, since a late activation is counted by then
+	aggregators are read one iteration later, which bounds the staleness to one for the programs that have any
+*/
+template<class KeyType, class ValueType, class WireType = ValueType>
+class SspEngine: public Engine<KeyType, ValueType, WireType>
+{
+private:
+	typedef Engine<KeyType, ValueType, WireType> Base;
+	typedef typename Base::VertexType VertexType;
+	typedef typename Base::ControllerType ControllerType;
+	typedef typename Base::GraphType GraphType;
+	typedef typename Base::VertexProgType VertexProgType;
+	typedef typename Base::Sync Sync;
+	typedef typename Base::SyncMesg SyncMesg;
+	typedef typename Base::VTYPE VTYPE;
+
+	using Base::comm;
+	using Base::mesg_buf;
+	using Base::graph;
+	using Base::v_prog;
+	using Base::rank;
+	using Base::mpi_size;
+	using Base::max_iterations;
+	using Base::acc_init;
+	using Base::fused;
+	using Base::num_updates;
+	using Base::low_master_active_array;
+	using Base::high_master_active_array;
+
+	// a rank runs at most staleness iterations ahead of the slowest one
+	int staleness;
+	int iteration = 0;
+	volatile int *clock; // iterations finished by every rank
+	// latest gathered value of every mirror rank for the local masters and its stamp, at rank * local vertices + Vertex::index
+	ValueType *partial;
+	int *partial_stamp;
+	// latest value for every local mirror and its stamp, at Vertex::index, held until the next iteration starts
+	ValueType *held_value;
+	int *value_stamp;
+	char *held;
+	static const int SSP_LOCKS = 64;
+	std::mutex ssp_lock[SSP_LOCKS];
+	// the mirrors with a held value, by lock
+	std::vector<LocalId> received[SSP_LOCKS];
+
+	inline void wait_clock(int min_clock);
+	inline void send_clock(int value);
+	inline int unwrap_stamp(int stamp);
+	inline void take_values();
+	inline ValueType ssp_total(VertexType *v, ValueType acc);
+	inline void engine_apply(std::pair<LocalId, LocalId*> active_array, VTYPE type, Sender<SyncMesg> *sender[]);
+
+	int partial_tag(bool high) {return ssp_tag(SSP_PARTIAL, iteration, rank, mpi_size);}
+	int value_tag(bool high) {return ssp_tag(SSP_VALUE, iteration, rank, mpi_size);}
+	void barrier() {}
+	void receive_until_barrier() {}
+	// activations arrive at any time, so they are taken out of the bitmaps atomically, and none are left to clear
+	bool next_active(BitMap &active_set, size_t *id) {return active_set.take_next_bit(id);}
+	void end_gather() {}
+	// the masters apply with the latest partials there are, which are not counted
+	void contribute(bool high, LocalId lid) {}
+	void prepare_gather();
+	void apply_masters(Sender<SyncMesg> *sender_low[], Sender<SyncMesg> *sender_high[]);
+
+public:
+	// whether v_prog can run in the stale synchronous mode, rank 0 says so when it cannot
+	static bool supported(ControllerType *controller, VertexProgType *v_prog);
+
+	template<class ProgType>
+	SspEngine(ControllerType *controller, GraphType *graph, ProgType *v_prog, int staleness):Base(controller, graph, v_prog), staleness(staleness)
+	{
+		// the stamps are told apart within half of the window
+		if(staleness > SSP_WINDOW / 4)
+		{
+			if(0 == rank)
+				printf("Staleness limited to %d\n", SSP_WINDOW / 4);
+			this->staleness = SSP_WINDOW / 4;
+		}
+
+		size_t num = graph->local_vertex.size();
+		clock = new int[mpi_size]();
+		partial = new ValueType[num * mpi_size];
+		partial_stamp = new int[num * mpi_size];
+		held_value = new ValueType[num];
+		value_stamp = new int[num];
+		held = new char[num]();
+		std::fill(partial, partial + num * mpi_size, acc_init);
+		std::fill(partial_stamp, partial_stamp + num * mpi_size, -1);
+		std::fill(value_stamp, value_stamp + num, -1);
+	}
+	~SspEngine()
+	{
+		delete []clock;
+		delete []partial;
+		delete []partial_stamp;
+		delete []held_value;
+		delete []value_stamp;
+		delete []held;
+	}
+
+	void run();
+	bool process_mesg(int tag, void *buf);
+};
+
+template<class KeyType, class ValueType, class WireType>
+bool SspEngine<KeyType, ValueType, WireType>::supported(ControllerType *controller, VertexProgType *v_prog)
+{
+	Communicator *comm = controller->comm;
+	int size = comm->get_size();
+	int *tag_ub, flag;
+	MPI_Comm_get_attr(comm->mpi_comm, MPI_TAG_UB, &tag_ub, &flag);
+	// mirror changes may be overwritten before they are posted to the cache, and the tags hold the stamps and ranks
+	// priority scheduling relies on every rank being in the same bucket
+	if(!v_prog->delta_cache() && v_prog->bucket_width() <= 0 && !(flag && ssp_tag(SSP_KINDS - 1, SSP_WINDOW - 1, size - 1, size) > *tag_ub))
+		return true;
+	if(0 == comm->get_rank())
+		printf("Stale synchronous mode not supported here, running synchronously\n");
+	return false;
+}
+
+template<class KeyType, class ValueType, class WireType>
+void SspEngine<KeyType, ValueType, WireType>::run()
+{
+	int window = staleness + 2;
+	unsigned long *local_active = new unsigned long[window];
+	unsigned long *global_active = new unsigned long[window];
+	MPI_Request *request = new MPI_Request[window];
+	bool conversed = false;
+	bool terminated = false;
+	int idle = 0; // reductions in a row without active vertices
+	int i = 0, j = 0; // the iteration and the next reduction to read
+	double wait_time = 0;
+
+	auto read_active = [&]()
+	{
+		MPI_Wait(request + j % window, MPI_STATUS_IGNORE);
+		unsigned long active = global_active[j % window];
+		if(0 == rank)
+			printf("Iteration: %d, global_active vertices: %lu\n", j, active);
+		idle = active ? 0 : idle + 1;
+		if(idle == window)
+			conversed = true;
+		j++;
+	};
+
+	MPI_Barrier(comm->mpi_comm);
+	double s = MPI_Wtime();
+	for (; !conversed && i < max_iterations; ++i)
+	{
+		iteration = i;
+		double start = MPI_Wtime();
+		wait_clock(i - staleness);
+		wait_time += MPI_Wtime() - start;
+		if(i && !v_prog->aggregators.empty())
+		{
+			for(auto aggregator : v_prog->aggregators)
+				aggregator->finish();
+			if((terminated = v_prog->terminate()))
+				break;
+		}
+
+		take_values();
+		this->execute_gather();
+		this->execute_apply();
+		for(auto aggregator : v_prog->aggregators)
+			aggregator->start(comm->mpi_comm);
+		this->execute_scatter();
+
+		local_active[i % window] = (graph->low_active_master).size() + (graph->high_active_master).size();
+		MPI_Iallreduce(local_active + i % window, global_active + i % window, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm->mpi_comm, request + i % window);
+		log("Rank: %d, iteration: %d, local active vertices: %lu\n", rank, i, local_active[i % window]);
+		clock[rank] = i + 1;
+		// every rank has started this reduction, as their clocks were at least i - staleness
+		if(i + 1 >= window)
+			read_active();
+		if(!conversed && i + 1 < max_iterations)
+			send_clock(i + 1);
+	}
+	if(!terminated && i && !v_prog->aggregators.empty())
+		for(auto aggregator : v_prog->aggregators)
+			aggregator->finish();
+	while(j < i)
+		read_active();
+	printf("Rank: %d, clock wait time: %lf (s)\n", rank, wait_time);
+
+	MPI_Barrier(comm->mpi_comm);
+	while(comm->is_receiving());
+	delete []local_active;
+	delete []global_active;
+	delete []request;
+	this->report(s);
+}
+
+template<class KeyType, class ValueType, class WireType>
+inline void SspEngine<KeyType, ValueType, WireType>::wait_clock(int min_clock)
+{
+	TRACE_SCOPE("wait clock");
+	for (int r = 0; r < mpi_size; ++r)
+		while(clock[r] < min_clock)
+			usleep(10);
+}
+
+template<class KeyType, class ValueType, class WireType>
+inline void SspEngine<KeyType, ValueType, WireType>::send_clock(int value)
+{
+	for (int r = 0; r < mpi_size; ++r)
+		if(r != rank)
+			comm->send(r, ssp_tag(SSP_CLOCK, 0, rank, mpi_size), &value, sizeof(int));
+}
+
+/*
+	iteration of a stamp modulo SSP_WINDOW, the one closest to the clock of this rank
+*/
+template<class KeyType, class ValueType, class WireType>
+inline int SspEngine<KeyType, ValueType, WireType>::unwrap_stamp(int stamp)
+{
+	int base = clock[rank] - SSP_WINDOW / 2;
+	return base + ((stamp - base) % SSP_WINDOW + SSP_WINDOW) % SSP_WINDOW;
+}
+
+/*
+	the mirrors take the values held for them, before the gathers read them
+	a mirror was activated when its value arrived, so it scatters the value in this iteration or the next
+*/
+template<class KeyType, class ValueType, class WireType>
+inline void SspEngine<KeyType, ValueType, WireType>::take_values()
+{
+	TRACE_SCOPE("take values");
+	#pragma omp parallel for num_threads(COMP_THREADS)
+	for (int l = 0; l < SSP_LOCKS; ++l)
+	{
+		std::lock_guard<std::mutex> lock(ssp_lock[l]);
+		for(LocalId index : received[l])
+		{
+			VertexType *v = graph->local_vertex[index];
+			ValueType old_value = v->get_value();
+			v->set_value(held_value[index]);
+			v->set_change(v->get_value() - old_value);
+			held[index] = 0;
+		}
+		received[l].clear();
+	}
+}
+
+/*
+	acc of a master combined with the latest gathered values of its mirrors
+*/
+template<class KeyType, class ValueType, class WireType>
+inline ValueType SspEngine<KeyType, ValueType, WireType>::ssp_total(VertexType *v, ValueType acc)
+{
+	auto pair_it = (graph->mirror).find(v->get_id());
+	if((graph->mirror).end() == pair_it)
+		return acc;
+	size_t num = graph->local_vertex.size();
+	std::lock_guard<std::mutex> lock(ssp_lock[v->index % SSP_LOCKS]);
+	for (int mirror_rank : pair_it->second)
+		acc = v_prog->op(partial[mirror_rank * num + v->index], acc);
+	return acc;
+}
+
+// the accumulators of the masters about to gather
+template<class KeyType, class ValueType, class WireType>
+void SspEngine<KeyType, ValueType, WireType>::prepare_gather()
+{
+	TRACE_SCOPE("prepare gather");
+	auto prepare = [&](std::pair<LocalId, LocalId*> &active_array, ValueType *local_buf)
+	{
+		#pragma omp parallel for num_threads(COMP_THREADS)
+		for (LocalId i = 0; i < active_array.first; ++i)
+			local_buf[active_array.second[i]] = acc_init;
+	};
+	prepare(low_master_active_array, mesg_buf->get_sync_buf_low());
+	prepare(high_master_active_array, mesg_buf->get_sync_buf_high());
+}
+
+template<class KeyType, class ValueType, class WireType>
+void SspEngine<KeyType, ValueType, WireType>::apply_masters(Sender<SyncMesg> *sender_low[], Sender<SyncMesg> *sender_high[])
+{
+	engine_apply(low_master_active_array, Base::LOW_MASTER, sender_low);
+	engine_apply(high_master_active_array, Base::HIGH_MASTER, sender_high);
+}
+
+template<class KeyType, class ValueType, class WireType>
+inline void SspEngine<KeyType, ValueType, WireType>::engine_apply(std::pair<LocalId, LocalId*> active_array, VTYPE type, Sender<SyncMesg> *sender[])
+{
+	TRACE_SCOPE(Base::trace_name(1, type));
+	double start = MPI_Wtime();
+
+	LocalId array_size = active_array.first;
+	LocalId *array = active_array.second;
+	num_updates += array_size;
+	ValueType *local_buf = (Base::LOW_MASTER == type) ? mesg_buf->get_sync_buf_low() : mesg_buf->get_sync_buf_high();
+
+	#pragma omp parallel for num_threads(COMP_THREADS) schedule(OMP_SCHEDULE_TYPE)
+	for (LocalId i = 0; i < array_size; ++i)
+	{
+		int thread_id = omp_get_thread_num();
+		LocalId lid = array[i];
+		VertexType *v = (Base::LOW_MASTER == type) ? graph->ltov_low_master[lid] : graph->ltov_high_master[lid];
+		if(fused && !v->replicated)
+			continue;
+		this->apply_master(v, ssp_total(v, local_buf[lid]), sender[thread_id]);
+	}
+	log("Apply update time: %lf\n", MPI_Wtime() - start);
+}
+
+/*
+	called by the worker threads for all the messages of the mode, older stamps than the kept ones are dropped,
+	as blocks of different iterations may be processed out of order
+*/
+template<class KeyType, class ValueType, class WireType>
+bool SspEngine<KeyType, ValueType, WireType>::process_mesg(int tag, void *buf)
+{
+	if(tag < SSP_TAG)
+		return false;
+	int source = (tag - SSP_TAG) % mpi_size;
+	int kind = (tag - SSP_TAG) / mpi_size % SSP_KINDS;
+	int stamp = unwrap_stamp((tag - SSP_TAG) / mpi_size / SSP_KINDS);
+	size_t num = graph->local_vertex.size();
+	switch(kind)
+	{
+		case SSP_CLOCK:
+		{
+			int value = *(int *)buf;
+			int old_value;
+			while((old_value = clock[source]) < value && !__sync_bool_compare_and_swap(clock + source, old_value, value));
+			break;
+		}
+		case SSP_PARTIAL:
+		{
+			Sync::for_each(buf, [&](KeyType id, const WireType &value)
+			{
+				LocalId index = graph->local_index(id);
+				size_t slot = source * num + index;
+				{
+					std::lock_guard<std::mutex> lock(ssp_lock[index % SSP_LOCKS]);
+					if(stamp <= partial_stamp[slot])
+						return;
+					partial_stamp[slot] = stamp;
+					partial[slot] = value;
+				}
+				// the master may have applied without it already
+				graph->insert_active_master(id);
+			});
+			break;
+		}
+		case SSP_VALUE:
+		{
+			Sync::for_each(buf, [&](KeyType id, const WireType &value)
+			{
+				LocalId index = graph->local_index(id);
+				{
+					std::lock_guard<std::mutex> lock(ssp_lock[index % SSP_LOCKS]);
+					if(stamp <= value_stamp[index])
+						return;
+					value_stamp[index] = stamp;
+					held_value[index] = value;
+					if(!held[index])
+					{
+						held[index] = 1;
+						received[index % SSP_LOCKS].push_back(index);
+					}
+				}
+				// the mirror need not be active in the iteration of the value here, as a partial alone activates
+				// the master, so it scatters the value in its next iteration
+				graph->insert_active_mirror(id);
+			});
+			break;
+		}
+		default: log("Wrong stale synchronous message: %d\n", tag); exit(0);
+	}
+	free(buf);
+	return true;
+}
+
+#endif
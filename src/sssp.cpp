@@ -1,89 +1,11 @@
 
 #include "controller.hpp"
 #include "graph.hpp"
+#include "stream.hpp"
 #include "engine.hpp"
-#include "vertexprogram.hpp"
-#include <algorithm>
-
-template<class KeyType, class ValueType>
-class Sssp: public VertexProgram<KeyType, ValueType>
-{
-private:
-	const ValueType delta = 0;
-	//ValueType change;
-	typedef Vertex<KeyType, ValueType> VertexType;
-
-public:
-	static KeyType source;
-	Sssp() {this->iterations = 64; this->acc_init = 1 << 30;}
-	~Sssp() {}
-	
-	EDGE_DIRECTION gather_edge() {return IN_EDGES;}
-	EDGE_DIRECTION gather_edge(VertexType &v)
-	{
-		if(v.get_id() == source)
-			return NO_EDGES;
-		else
-			return IN_EDGES;
-	}
-	
-	EDGE_DIRECTION scatter_edge() {return OUT_EDGES;}
-	EDGE_DIRECTION scatter_edge(VertexType &v)
-	{
-		if(delta != v.change)
-			return OUT_EDGES;
-		else
-			return NO_EDGES;
-	}
-
-	ValueType gather(VertexType &v, VertexType &nbr)
-	{
-		return nbr.get_value();
-	}
-
-	ValueType op(ValueType x, ValueType y)
-	{
-		return std::min(x, y);
-	}
-
-	void apply(VertexType &v, ValueType total)
-	{
-		ValueType old_value = v.get_value();
-		v.set_value(std::min(old_value, total + 1));
-		if(v.get_id() == source)
-			v.set_value(0);
-		v.change = v.get_value() - old_value;
-		// log("Warning: %d: old_value:%d, new_value:%d\n", v.get_id(), old_value, v.get_value());
-	}
-
-	bool scatter(VertexType &v, VertexType &nbr)
-	{
-		if(v.get_value() + 1 < nbr.get_value())
-		{
-			// log("Warning: %d(%d) activate %d(%d)\n", v.get_id(), v.get_value(), nbr.get_id(), nbr.get_value());
-			return true;
-		}
-		else
-			return false;
-	}
-	
-	static bool init_vertex(VertexType &v)
-	{
-		if(v.get_id() == source)
-		{
-			v.set_value(1 << 30);
-			v.is_active = true;
-			return true; // active
-		}
-		else
-		{
-			v.set_value(1 << 30);
-			v.is_active = false;
-			return false; // inactive
-		}
-	}
-
-};
+#include "ssp_engine.hpp"
+#include "async_engine.hpp"
+#include "sssp.hpp"
 
 template<class KeyType, class ValueType>
 ValueType op(ValueType x, ValueType y)
@@ -91,16 +13,27 @@ ValueType op(ValueType x, ValueType y)
 	return std::min(x, y);
 }
 
-template<class KeyType, class ValueType>
-KeyType Sssp<KeyType, ValueType>::source = 0;
-
 int main(int argc, char *argv[])
 {
 	int opt;
 	char *file_path = NULL;
 	size_t threshold = 1000;
+	int reorder_type = REORDER_NONE;
+	bool compressed = false;
+	bool weighted = false;
+	int id_bits = 32;
+	char *output = NULL;
+	int output_type = OUTPUT_TEXT;
+	char *checkpoint = NULL;
+	int period = 10;
+	bool restart = false;
+	char *prior = NULL;
+	char *updates = NULL;
+	char *feed = NULL;
+	bool async = false;
+	int staleness = -1;
 
-    while ((opt = getopt(argc, argv, "g:t:s:")) != -1) {
+    while ((opt = getopt(argc, argv, "g:t:s:r:cwi:aS:d:o:O:W:U:F:C:P:R")) != -1) {
         switch (opt) {
         case 'g':
             file_path = optarg;
@@ -108,28 +41,132 @@ int main(int argc, char *argv[])
         case 't':
             threshold = (size_t)atoi(optarg);
             break;
+        case 'r':
+            reorder_type = atoi(optarg);
+            break;
+        case 'c':
+            compressed = true;
+            break;
+        case 'w':
+            weighted = true;
+            break;
+        case 'i':
+            id_bits = atoi(optarg);
+            break;
+        case 'a':
+            async = true;
+            break;
+        case 'S':
+            staleness = atoi(optarg);
+            break;
         case 's':
-        	Sssp<unsigned int, unsigned int>::source = atoi(optarg);
+        	Sssp<VertexId, float>::source = strtoull(optarg, NULL, 10);
+        	break;
+        case 'd':
+        	Sssp<VertexId, float>::width = atof(optarg);
         	break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'O':
+            output_type = atoi(optarg);
+            break;
+        case 'C':
+            checkpoint = optarg;
+            break;
+        case 'P':
+            period = atoi(optarg);
+            break;
+        case 'R':
+            restart = true;
+            break;
+        case 'W':
+            prior = optarg;
+            break;
+        case 'U':
+            updates = optarg;
+            break;
+        case 'F':
+            feed = optarg;
+            break;
         default:
-            fprintf(stderr, "Usage: %s [-g graph] [-t threshold] [-s source]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-s source] [-r reorder] [-c] [-w] [-i id bits] [-a] [-S staleness] [-d bucket width] [-o output] [-O output type] [-W prior results] [-U edge updates] [-F edge stream] [-C checkpoint] [-P checkpoint period] [-R]\n", argv[0]);
             exit(EXIT_FAILURE);
         }
     }
 
 	if (file_path == NULL) {
-		fprintf(stderr, "Usage: %s [-g graph] [-t threshold] [-s source]\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-g graph file, directory or glob] [-t threshold] [-s source] [-r reorder] [-c] [-w] [-i id bits] [-a] [-S staleness] [-d bucket width] [-o output] [-O output type] [-W prior results] [-U edge updates] [-F edge stream] [-C checkpoint] [-P checkpoint period] [-R]\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
-	Controller<unsigned int, unsigned int> controller;
+	Controller<VertexId, float> controller;
 
-	Sssp<unsigned int, unsigned int> sssp;
+	Sssp<VertexId, float> sssp;
+	// every bucket takes a few iterations
+	if(Sssp<VertexId, float>::width > 0)
+		sssp.iterations = INT_MAX;
 	
-	Graph<unsigned int, unsigned int> graph(&controller, file_path, threshold, 1);
-	graph.transform_vertices(Sssp<unsigned int, unsigned int>::init_vertex);
+	Graph<VertexId, float> graph(&controller, file_path, threshold, 1, reorder_type, compressed, weighted, id_bits);
+	graph.transform_vertices(Sssp<VertexId, float>::init_vertex, prior);
+	// the asynchronous engine applies in buckets of distances, as wide as the mean edge weight unless -d is given
+	if(async && Sssp<VertexId, float>::width <= 0)
+		Sssp<VertexId, float>::width = graph.mean_edge_weight();
 	
-	Engine<unsigned int, unsigned int> engine(&controller, &graph, &sssp);
-	engine.run();
+	auto run = [&]()
+	{
+		if(async)
+		{
+			AsyncEngine<VertexId, float> engine(&controller, &graph, &sssp);
+			engine.run();
+		}
+		else if(staleness >= 0 && SspEngine<VertexId, float>::supported(&controller, &sssp))
+		{
+			SspEngine<VertexId, float> engine(&controller, &graph, &sssp, staleness);
+			engine.run();
+		}
+		else
+		{
+			Engine<VertexId, float> engine(&controller, &graph, &sssp);
+			// only the run on the loaded graph is checkpointed
+			if(checkpoint)
+				engine.set_checkpoint(checkpoint, period, restart);
+			checkpoint = NULL;
+			engine.run();
+		}
+	};
+	run();
+
+	// then from the distances of the graph before the updates
+	if(updates)
+	{
+		std::vector<EdgeUpdate<VertexId> > batch;
+		if(0 == controller.comm->get_rank() && !read_updates(updates, batch))
+		{
+			fprintf(stderr, "Cannot read %s\n", updates);
+			MPI_Abort(controller.comm->mpi_comm, EXIT_FAILURE);
+		}
+		// distances only decrease, they are computed again once edges are deleted
+		if(graph.update_edges(batch, Sssp<VertexId, float>::init_vertex))
+			graph.reset_vertices(Sssp<VertexId, float>::init_vertex);
+		run();
+	}
+	// and round after round from the updates arriving on the stream, until it ends
+	if(feed)
+	{
+		EdgeStream<VertexId, float> stream(&controller, &graph, feed);
+		std::vector<EdgeUpdate<VertexId> > batch;
+		while(stream.next(batch))
+		{
+			// distances only decrease, they are computed again once edges are deleted
+			if(graph.update_edges(batch, Sssp<VertexId, float>::init_vertex))
+				graph.reset_vertices(Sssp<VertexId, float>::init_vertex);
+			run();
+			stream.visible();
+		}
+	}
+
+	if(output)
+		graph.write_values(output, output_type);
 	return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file
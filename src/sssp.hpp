@@ -0,0 +1,105 @@
+#ifndef SSSP
+#define SSSP
+
+#include "vertexprogram.hpp"
+#include <algorithm>
+
+template<class KeyType, class ValueType>
+class Sssp: public VertexProgram<KeyType, ValueType>
+{
+private:
+	const ValueType delta = 0;
+	//ValueType change;
+	typedef Vertex<KeyType, ValueType> VertexType;
+
+public:
+	static KeyType source;
+	static double width; // of the buckets of distances, 0 for plain relaxation
+	Sssp() {this->iterations = 64; this->acc_init = 1 << 30;}
+	~Sssp() {}
+	
+	EDGE_DIRECTION gather_edge() {return IN_EDGES;}
+	EDGE_DIRECTION gather_edge(VertexType &v)
+	{
+		if(v.get_id() == source)
+			return NO_EDGES;
+		else
+			return IN_EDGES;
+	}
+	
+	EDGE_DIRECTION scatter_edge() {return OUT_EDGES;}
+	EDGE_DIRECTION scatter_edge(VertexType &v)
+	{
+		if(delta != v.get_change())
+			return OUT_EDGES;
+		else
+			return NO_EDGES;
+	}
+
+	ValueType gather(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		return nbr.get_value() + weight;
+	}
+
+	ValueType op(ValueType x, ValueType y)
+	{
+		return std::min(x, y);
+	}
+
+	// values only decrease, so reading a new value within the iteration only gets there sooner
+	bool fused_apply() {return true;}
+
+	// delta-stepping: distances are settled bucket by bucket
+	double bucket_width() {return width;}
+	double priority(VertexType &v, ValueType total)
+	{
+		if(v.get_id() == source)
+			return 0;
+		return std::min(v.get_value(), total);
+	}
+
+	void apply(VertexType &v, ValueType total)
+	{
+		ValueType old_value = v.get_value();
+		v.set_value(std::min(old_value, total));
+		if(v.get_id() == source)
+			v.set_value(0);
+		v.set_change(v.get_value() - old_value);
+		// log("Warning: %d: old_value:%d, new_value:%d\n", v.get_id(), old_value, v.get_value());
+	}
+
+	bool scatter(VertexType &v, VertexType &nbr, WeightType weight)
+	{
+		if(v.get_value() + weight < nbr.get_value())
+		{
+			// log("Warning: %d(%d) activate %d(%d)\n", v.get_id(), v.get_value(), nbr.get_id(), nbr.get_value());
+			return true;
+		}
+		else
+			return false;
+	}
+	
+	static bool init_vertex(VertexType &v)
+	{
+		if(v.get_id() == source)
+		{
+			v.set_value(1 << 30);
+			v.set_active(true);
+			return true; // active
+		}
+		else
+		{
+			v.set_value(1 << 30);
+			v.set_active(false);
+			return false; // inactive
+		}
+	}
+
+};
+
+template<class KeyType, class ValueType>
+KeyType Sssp<KeyType, ValueType>::source = 0;
+template<class KeyType, class ValueType>
+double Sssp<KeyType, ValueType>::width = 0;
+
+#endif
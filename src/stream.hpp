@@ -0,0 +1,237 @@
+#ifndef STREAM
+#define STREAM
+
+#include <mpi.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "controller.hpp"
+#include "graph.hpp"
+
+/*
+	edge updates arriving continuously, on a pipe or appended to a file, a line each as parse_update reads them
+	rank 0 tails the stream in a thread of its own, which stamps every update with its arrival time
+	next() takes the updates arrived since the last round and routes them to the ranks of their dst, they are
+	applied by update_edges between the runs of the engine, and visible() marks them reflected in the results:
+		latency, from the arrival of an update to the end of the run that reflects it
+		staleness, the age of the oldest update not reflected yet when the results of a round are done
+	the stream ends when the writer closes the pipe, or when the file has not grown for idle seconds
+*/
+template<class KeyType, class ValueType>
+class EdgeStream
+{
+private:
+	typedef Graph<KeyType, ValueType> GraphType;
+
+	struct Arrival
+	{
+		EdgeUpdate<KeyType> update;
+		double time;
+	};
+
+	Communicator *comm;
+	GraphType *graph;
+	const char *path;
+	double idle;
+	int rank;
+
+	// filled by the reader thread of rank 0
+	pthread_t reader_thread;
+	std::mutex lock;
+	std::deque<Arrival> arrivals;
+	size_t num_ignored = 0;
+	bool ended = false;
+
+	// arrival times of the updates of the current round
+	std::vector<double> round;
+	double start;
+	double last_visible;
+	int num_rounds = 0;
+	size_t num_updates = 0;
+	double latency_sum = 0, latency_max = 0;
+	double staleness_sum = 0, staleness_max = 0;
+
+	static void *read(void *arg);
+	void report();
+
+public:
+	EdgeStream(Controller<KeyType, ValueType> *controller, GraphType *graph, const char *path, double idle = 5);
+	~EdgeStream();
+
+	// the updates of this rank arrived since the last round, false once the stream ended, collective
+	bool next(std::vector<EdgeUpdate<KeyType> > &batch);
+	// the updates of the round are reflected in the results
+	void visible();
+};
+
+template<class KeyType, class ValueType>
+EdgeStream<KeyType, ValueType>::EdgeStream(Controller<KeyType, ValueType> *controller, GraphType *graph, const char *path, double idle):
+	comm(controller->comm), graph(graph), path(path), idle(idle)
+{
+	rank = comm->get_rank();
+	start = last_visible = MPI_Wtime();
+	if(0 == rank)
+		pthread_create(&reader_thread, NULL, EdgeStream<KeyType, ValueType>::read, this);
+}
+
+template<class KeyType, class ValueType>
+EdgeStream<KeyType, ValueType>::~EdgeStream()
+{
+	if(0 != rank)
+		return;
+	// the reader may still wait for a line when the stream is left before its end
+	bool done;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		done = ended;
+	}
+	if(!done)
+		pthread_cancel(reader_thread);
+	pthread_join(reader_thread, NULL);
+}
+
+template<class KeyType, class ValueType>
+void *EdgeStream<KeyType, ValueType>::read(void *arg)
+{
+	EdgeStream<KeyType, ValueType> *stream = (EdgeStream<KeyType, ValueType> *)arg;
+	// blocks until a pipe has a writer
+	FILE *fp = fopen(stream->path, "r");
+	if(!fp)
+	{
+		fprintf(stderr, "Cannot open %s\n", stream->path);
+		std::lock_guard<std::mutex> guard(stream->lock);
+		stream->ended = true;
+		return NULL;
+	}
+	struct stat st;
+	fstat(fileno(fp), &st);
+	bool pipe = S_ISFIFO(st.st_mode);
+
+	// a line may be read in parts while it is written
+	std::string line;
+	auto take = [&]() {
+		EdgeUpdate<KeyType> update;
+		bool valid = parse_update(line.c_str(), update);
+		bool blank = (line.find_first_not_of(" \t\r\n") == std::string::npos);
+		double time = MPI_Wtime();
+		std::lock_guard<std::mutex> guard(stream->lock);
+		if(valid)
+			stream->arrivals.push_back(Arrival{update, time});
+		else if(!blank)
+			stream->num_ignored++;
+		line.clear();
+	};
+
+	char buf[256];
+	double last_read = MPI_Wtime();
+	while(true)
+	{
+		if(fgets(buf, sizeof(buf), fp))
+		{
+			line += buf;
+			if('\n' == line.back())
+				take();
+			last_read = MPI_Wtime();
+			continue;
+		}
+		if(pipe || MPI_Wtime() - last_read > stream->idle)
+			break;
+		// the end of the file so far, wait for it to grow
+		clearerr(fp);
+		usleep(1000);
+	}
+	if(!line.empty())
+		take();
+	fclose(fp);
+	std::lock_guard<std::mutex> guard(stream->lock);
+	stream->ended = true;
+	return NULL;
+}
+
+template<class KeyType, class ValueType>
+bool EdgeStream<KeyType, ValueType>::next(std::vector<EdgeUpdate<KeyType> > &batch)
+{
+	batch.clear();
+	round.clear();
+	// rank 0 waits for updates, the other ranks for rank 0 without holding the cpu
+	int more = 1;
+	if(0 == rank)
+	{
+		while(true)
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if(!arrivals.empty())
+				{
+					for(auto &arrival : arrivals)
+					{
+						batch.push_back(arrival.update);
+						round.push_back(arrival.time);
+					}
+					arrivals.clear();
+					break;
+				}
+				if(ended)
+				{
+					more = 0;
+					break;
+				}
+			}
+			usleep(1000);
+		}
+	}
+	MPI_Request req;
+	MPI_Ibcast(&more, 1, MPI_INT, 0, comm->mpi_comm, &req);
+	int flag = 0;
+	while(MPI_Test(&req, &flag, MPI_STATUS_IGNORE), !flag)
+		usleep(100);
+	if(!more)
+	{
+		report();
+		return false;
+	}
+	graph->route_updates(batch);
+	return true;
+}
+
+template<class KeyType, class ValueType>
+void EdgeStream<KeyType, ValueType>::visible()
+{
+	if(0 != rank)
+		return;
+	double now = MPI_Wtime();
+	for(double time : round)
+	{
+		latency_sum += now - time;
+		latency_max = std::max(latency_max, now - time);
+	}
+	size_t pending;
+	double staleness;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending = arrivals.size();
+		staleness = pending ? now - arrivals.front().time : 0;
+	}
+	staleness_sum += staleness;
+	staleness_max = std::max(staleness_max, staleness);
+	num_updates += round.size();
+	num_rounds++;
+	last_visible = now;
+	printf("Round: %d, updates: %lu, max latency: %lf (s), pending updates: %lu, staleness: %lf (s)\n", num_rounds, round.size(), round.empty() ? 0 : now - round.front(), pending, staleness);
+	fflush(stdout);
+}
+
+template<class KeyType, class ValueType>
+void EdgeStream<KeyType, ValueType>::report()
+{
+	if(0 != rank)
+		return;
+	double time = last_visible - start;
+	printf("Stream: %s, updates: %lu, ignored lines: %lu, rounds: %d, time: %lf (s), ingestion rate: %lf (updates/s)\n", path, num_updates, num_ignored, num_rounds, time, time > 0 ? num_updates / time : 0);
+	printf("Latency: mean: %lf (s), max: %lf (s), staleness: mean: %lf (s), max: %lf (s)\n", num_updates ? latency_sum / num_updates : 0, latency_max, num_rounds ? staleness_sum / num_rounds : 0, staleness_max);
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef TRACE
+#define TRACE
+
+/*
+	timeline of the runs in the trace event format of chrome, built with make TRACE=1 and left out entirely otherwise
+	every thread records its scopes, a name, begin and duration each, into a ring of its own without any lock,
+	which keeps the last TRACE_EVENTS of them
+	at exit the ranks write their events together into TRACE_FILE, a process per rank and a track per thread,
+	to be opened in chrome://tracing or ui.perfetto.dev
+	the clocks of the ranks start at the same barrier, so the tracks of different hosts line up within its latency
+*/
+
+#ifdef TRACE_TIMELINE
+
+#include <mpi.h>
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef TRACE_FILE
+#define TRACE_FILE "trace.json"
+#endif
+// per thread
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 65536
+#endif
+
+struct TraceEvent
+{
+	const char *name; // a literal
+	double begin;
+	double duration;
+};
+
+struct TraceRing
+{
+	int tid;
+	size_t count = 0; // of all the events recorded, the last TRACE_EVENTS are kept
+	TraceEvent events[TRACE_EVENTS];
+
+	inline void add(const char *name, double begin, double end)
+	{
+		events[count++ % TRACE_EVENTS] = TraceEvent{name, begin, end - begin};
+	}
+};
+
+class Trace
+{
+private:
+	double t0 = 0;
+	std::mutex lock;
+	// of all the threads that recorded, kept once they exit
+	std::vector<TraceRing *> rings;
+
+public:
+	static Trace &get() {static Trace trace; return trace;}
+
+	// the ring of the calling thread, registered on its first event
+	inline TraceRing *ring()
+	{
+		static thread_local TraceRing *ring = NULL;
+		if(!ring)
+		{
+			ring = new TraceRing();
+			std::lock_guard<std::mutex> guard(lock);
+			ring->tid = rings.size();
+			rings.push_back(ring);
+		}
+		return ring;
+	}
+
+	// collective
+	void init(MPI_Comm comm)
+	{
+		MPI_Barrier(comm);
+		t0 = MPI_Wtime();
+	}
+	// once no thread records any more, collective
+	void write(MPI_Comm comm);
+};
+
+void Trace::write(MPI_Comm comm)
+{
+	int rank, size;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	// every rank has its process name first, so the elements of the others follow a comma
+	std::string out = (0 == rank) ? "[\n" : ",\n";
+	char buf[256];
+	snprintf(buf, sizeof(buf), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}", rank, rank);
+	out += buf;
+	unsigned long num_events = 0, num_dropped = 0;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		for(TraceRing *ring : rings)
+		{
+			size_t first = (ring->count > TRACE_EVENTS) ? ring->count - TRACE_EVENTS : 0;
+			for(size_t i = first; i < ring->count; ++i)
+			{
+				TraceEvent &event = ring->events[i % TRACE_EVENTS];
+				snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					event.name, rank, ring->tid, (event.begin - t0) * 1e6, event.duration * 1e6);
+				out += buf;
+			}
+			num_events += ring->count - first;
+			num_dropped += first;
+		}
+	}
+	if(size - 1 == rank)
+		out += "\n]\n";
+
+	long long bytes = out.size(), offset = 0;
+	MPI_Exscan(&bytes, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+	if(0 == rank)
+		offset = 0;
+	MPI_File fh;
+	if(MPI_SUCCESS != MPI_File_open(comm, TRACE_FILE, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh))
+	{
+		if(0 == rank)
+			fprintf(stderr, "Cannot open %s\n", TRACE_FILE);
+		return;
+	}
+	MPI_File_set_size(fh, 0);
+	MPI_File_write_at_all(fh, offset, out.data(), out.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+	MPI_File_close(&fh);
+
+	unsigned long local[2] = {num_events, num_dropped}, global[2];
+	MPI_Reduce(local, global, 2, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
+	if(0 == rank)
+		printf("Trace: %s, events: %lu, dropped: %lu\n", TRACE_FILE, global[0], global[1]);
+}
+
+// records the lifetime of the scope it is declared in
+class TraceScope
+{
+private:
+	const char *name;
+	double begin;
+
+public:
+	TraceScope(const char *name): name(name), begin(MPI_Wtime()) {}
+	~TraceScope() {Trace::get().ring()->add(name, begin, MPI_Wtime());}
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_INIT(comm) Trace::get().init(comm)
+#define TRACE_WRITE(comm) Trace::get().write(comm)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_INIT(comm)
+#define TRACE_WRITE(comm)
+
+#endif
+
+#endif
@@ -4,26 +4,75 @@
 #define VERTEX
 
 #include <vector>
+#include "compress.hpp"
+
+#include <stdint.h>
+
+/*
+	global vertex id of the applications, 64 bits when compiled with VERTEX_ID_64
+*/
+#ifdef VERTEX_ID_64
+typedef uint64_t VertexId;
+#else
+typedef uint32_t VertexId;
+#endif
+
+// index of a vertex among the local vertices of a rank, kept 32 bits on the hot path
+typedef uint32_t LocalId;
+
+// type of edge values
+typedef float WeightType;
 
 template <class KeyType, class ValueType>
 class Vertex;
 
+/*
+	values, changes and active flags of the local vertices of a graph, indexed by Vertex::index,
+	apart from the vertices, so that passes over all of them read contiguous arrays
+*/
+template <class ValueType>
+struct VertexState
+{
+	std::vector<ValueType> value;
+	std::vector<ValueType> change;
+	// set once a vertex is activated for the next iteration, read and written by several threads
+	std::vector<uint8_t> active;
+
+	inline void assign(size_t num, ValueType init)
+	{
+		value.assign(num, init);
+		change.assign(num, ValueType());
+		active.assign(num, 0);
+	}
+};
+
 template <class KeyType, class ValueType>
 class Vertex
 {
 private:
 	KeyType id;
-	ValueType value;
+	// the arrays of the graph that hold the value, change and active flag at index
+	VertexState<ValueType> *state;
 	std::vector<KeyType> *in_nbrs; // id <- nbr
 	std::vector<KeyType> *out_nbrs; // id -> nbr
-
+	std::vector<WeightType> *in_weights; // weights of in_nbrs, weighted graph only
+	std::vector<WeightType> *out_weights; // weights of out_nbrs, weighted graph only
 
 public:
-	std::vector<Vertex<KeyType, ValueType> *> in_nbrs_v;
-	std::vector<Vertex<KeyType, ValueType> *> out_nbrs_v;
-	ValueType change;
-	volatile bool is_active;
-	Vertex(KeyType id, ValueType value): id(id), value(value)
+	// local indexes of nbrs, see Graph::local_vertex
+	std::vector<LocalId> in_nbrs_i;
+	std::vector<LocalId> out_nbrs_i;
+	// compressed local indexes of nbrs, used instead of in/out_nbrs_i in compressed mode
+	CompressedList in_nbrs_c;
+	CompressedList out_nbrs_c;
+	// position of the vertex in Graph::local_vertex and in the state arrays
+	LocalId index;
+	// a mirror, or a master with mirrors on other ranks, set by the graph once loaded
+	bool replicated;
+	// weights of in nbrs followed by weights of out nbrs in the edge value array of the graph
+	size_t edge_offset;
+	// the state is set by the graph once the local indexes are assigned
+	Vertex(KeyType id): id(id), state(NULL), in_weights(NULL), out_weights(NULL), index(0), edge_offset(0)
 	{
 		in_nbrs = new std::vector<KeyType>;
 		out_nbrs = new std::vector<KeyType>;
@@ -36,8 +85,13 @@ public:
 	}
 
 	inline KeyType &get_id() {return id;}
-	inline ValueType &get_value() {return value;}
-	inline void set_value(ValueType val) {value = val;}
+	inline ValueType &get_value() {return state->value[index];}
+	inline void set_value(ValueType val) {state->value[index] = val;}
+	inline ValueType &get_change() {return state->change[index];}
+	inline void set_change(ValueType val) {state->change[index] = val;}
+	inline bool is_active() {return ((volatile uint8_t *)state->active.data())[index];}
+	inline void set_active(bool active) {((volatile uint8_t *)state->active.data())[index] = active;}
+	inline void set_state(VertexState<ValueType> *vertex_state) {state = vertex_state;}
 
 	inline void add_in_nbr(KeyType src) {in_nbrs->push_back(src);}
 	inline std::vector<KeyType>& get_in_nbr() {return *in_nbrs;}
@@ -45,17 +99,42 @@ public:
 	inline void add_out_nbr(KeyType dst) {out_nbrs->push_back(dst);}
 	inline std::vector<KeyType>& get_out_nbr() {return *out_nbrs;}
 
-	inline size_t in_nbrs_size() { return in_nbrs_v.size(); }
-	inline size_t out_nbrs_size() { return out_nbrs_v.size(); }
+	inline std::vector<WeightType>& get_in_weight()
+	{
+		if(!in_weights)
+			in_weights = new std::vector<WeightType>;
+		return *in_weights;
+	}
+	inline std::vector<WeightType>& get_out_weight()
+	{
+		if(!out_weights)
+			out_weights = new std::vector<WeightType>;
+		return *out_weights;
+	}
+
+	inline size_t in_nbrs_size() { return in_nbrs_i.size() + in_nbrs_c.size(); }
+	inline size_t out_nbrs_size() { return out_nbrs_i.size() + out_nbrs_c.size(); }
+
+	// the nbr vectors are freed once the graph is loaded, and allocated again while edges are updated
+	inline bool has_nbr_vec() {return NULL != in_nbrs;}
+	inline void alloc_nbr_vec()
+	{
+		in_nbrs = new std::vector<KeyType>;
+		out_nbrs = new std::vector<KeyType>;
+	}
 
 	inline void clear_nbr_vec()
 	{
 		delete in_nbrs;
 		delete out_nbrs;
+		delete in_weights;
+		delete out_weights;
 		in_nbrs = NULL;
 		out_nbrs = NULL;
+		in_weights = NULL;
+		out_weights = NULL;
 	}
 };
 
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #ifndef VERTEXPROGRAM
 #define VERTEXPROGRAM
 
+#include "aggregator.hpp"
+
 typedef enum
 {
 	NO_EDGES = 0, // b'00
@@ -17,8 +19,15 @@ class VertexProgram
 private:
 	typedef Vertex<KeyType, ValueType> VertexType;
 public:
+	/*
+		type of the values in the messages of the engine, which a program may narrow, e.g. typedef float WireType;
+		for double values, the engine of the program is built with it, Engine<KeyType, ValueType, typename ProgType::WireType>
+	*/
+	typedef ValueType WireType;
 	int iterations;
 	ValueType acc_init;
+	// reduced after every apply, see aggregator.hpp
+	std::vector<AggregatorBase *> aggregators;
 	VertexProgram() {}
 	~VertexProgram() {}
 
@@ -26,10 +35,51 @@ public:
 	virtual EDGE_DIRECTION gather_edge(VertexType &v) = 0;
 	virtual EDGE_DIRECTION scatter_edge() = 0;
 	virtual EDGE_DIRECTION scatter_edge(VertexType &v) = 0;
-	virtual ValueType gather(VertexType &v, VertexType &nbr) = 0;
+	// weight is the value of the edge between v and nbr, 1 on unweighted graphs
+	virtual ValueType gather(VertexType &v, VertexType &nbr, WeightType weight) = 0;
 	virtual ValueType op(ValueType x, ValueType y) = 0;
 	virtual void apply(VertexType &v, ValueType total) = 0;
-	virtual bool scatter(VertexType &v, VertexType &nbr) = 0;
+	virtual bool scatter(VertexType &v, VertexType &nbr, WeightType weight) = 0;
+
+	/*
+		dense gather, for programs whose gather depends on the nbr only and whose op is a sum:
+		the engine computes contribution() of every local vertex once per iteration into an array
+		and sums it over the gathered nbrs, ignoring the edge weights
+	*/
+	virtual bool dense_gather() {return false;}
+	virtual ValueType contribution(VertexType &v) {return v.get_value();}
+
+	/*
+		fused apply of the masters without mirrors, which get no partial from other ranks:
+		the engine applies them as soon as they are gathered, without a separate apply pass over them,
+		so other vertices may gather their new value within the same iteration
+		this is safe for dense gathers, which read the contributions of the start of the iteration,
+		and for programs that reach the same values either way, like sssp and cc
+	*/
+	virtual bool fused_apply() {return dense_gather();}
+
+	/*
+		delta caching, for programs whose op is invertible:
+		the engine keeps the gathered value of every vertex and reuses it instead of gathering again,
+		when the value of a vertex changes it adds gather_delta() into the cached values of the vertices gathering it
+		gather_delta(v, nbr, weight) is the change of gather(v, nbr, weight) caused by the last change of nbr,
+		whose change must then hold a value that is false (!change) when the vertex did not change
+	*/
+	virtual bool delta_cache() {return false;}
+	virtual ValueType gather_delta(VertexType &v, VertexType &nbr, WeightType weight) {return acc_init;}
+
+	/*
+		priority scheduling, as in delta-stepping, for programs returning a positive bucket_width():
+		the masters are applied bucket by bucket of their priority(), lowest first, and a master whose priority would
+		fall in a later bucket than the current one keeps its value until then
+		edges heavier than the width are scattered once the bucket of their vertex is done, the light ones as usual
+		priority(v, total) is the priority v gets when applied with total, buckets start at priority 0
+	*/
+	virtual double bucket_width() {return 0;}
+	virtual double priority(VertexType &v, ValueType total) {return 0;}
+
+	// checked after every iteration once the aggregators are reduced, true stops the engine
+	virtual bool terminate() {return false;}
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
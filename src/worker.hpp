@@ -38,6 +38,7 @@ void *Worker<KeyType, ValueType>::run(void *arg)
 			int tag;
 			void *recv_buf = NULL;
 			(worker->comm)->recv_loop(worker->loop, &tag, &recv_buf);
+			TRACE_SCOPE("process messages");
 			(worker->mesg_buf)->process_mesg(tag, recv_buf);
 		}
 
@@ -45,4 +46,4 @@ void *Worker<KeyType, ValueType>::run(void *arg)
 	return NULL;
 }
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file